@@ -4,13 +4,29 @@
 #include "timerange.hpp"
 #include "storage.hpp"
 #include "monitor.hpp"
+#include "threads.hpp"
 #include "coupled.hpp"
 #include "stagecache.hpp"
+#include "mmapstagecache.hpp"
+#include "compressedstagecache.hpp"
 #include "system.hpp"
+#include "phi.hpp"
+#include "jacobian.hpp"
+#include "newtonkrylov.hpp"
 #include "stepping.hpp"
 
 #include "steps/generic.hpp"
 #include "steps/rk4.hpp"
+#include "steps/explicitrk.hpp"
+#include "steps/embeddedrk.hpp"
+#include "steps/lowstoragerk.hpp"
 #include "steps/cb3r2r.hpp"
+#include "steps/cb4r3r.hpp"
 #include "steps/cnrk2.hpp"
-#include "flow.hpp"
\ No newline at end of file
+#include "steps/etdrk.hpp"
+#include "steps/multistep.hpp"
+#include "steps/rosenbrock.hpp"
+#include "steps/dirk.hpp"
+#include "steps/multirate.hpp"
+#include "flow.hpp"
+#include "checkpoint.hpp"
\ No newline at end of file
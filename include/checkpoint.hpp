@@ -0,0 +1,580 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "coupled.hpp"
+#include "stagecache.hpp"
+#include "stepping.hpp"
+#include "storage.hpp"
+#include "threads.hpp"
+#include "timerange.hpp"
+#include "steps/generic.hpp"
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Binomial coefficient (a b), zero if b < 0 or a < b
+inline std::size_t _binomial(long a, long b) {
+    if (b < 0 || a < b)
+        return 0;
+    std::size_t r = 1;
+    for (long k = 1; k <= b; k++)
+        r = r * (a - b + k) / k;
+    return r;
+}
+
+// Length of the first segment in the optimal reversal of n > 1 steps with
+// s snapshots, including the one at the start, following the schedule of
+// Griewank's revolve. With t the smallest number of repetitions such that
+// the binomial (s + t, s) is at least n, the split minimises the number of
+// forward steps, which is then t n - (s + t, t - 1).
+inline std::size_t _revolve_split(std::size_t n, std::size_t s) {
+    const long  S    = long(s);
+    long        t    = 0;
+    std::size_t beta = 1;
+    while (beta < n) {
+        t++;
+        beta = beta * (S + t) / t;
+    }
+    const std::size_t b1 = _binomial(S + t - 1, S);
+    const std::size_t b2 = _binomial(S + t - 2, S - 1);
+    const std::size_t b3 = _binomial(S + t - 3, S - 2);
+    const std::size_t b4 = _binomial(S + t - 2, S);
+    const std::size_t b5 = _binomial(S + t - 3, S - 3);
+
+    std::size_t m;
+    if (n <= b1 + b3) {
+        m = b4;
+    } else if (n >= beta - b5) {
+        m = b1;
+    } else {
+        m = n - b2 - b3;
+    }
+    return m < 1 ? 1 : (m > n - 1 ? n - 1 : m);
+}
+
+////////////////////////////////////////////////////////////////
+// Snapshots of the checkpointing schedule, in two levels. The first
+// slots are spilled to files in a directory, and the last 'nram' ones
+// are kept in memory. In the binomial schedule the last slots are the
+// most used, while the first ones are written and read a few times
+// only. The files are written and read on a background thread, from
+// and into two buffers, so that the memory is that of nram + 2 states.
+// A stored snapshot is copied into the write buffer, where it can also
+// be read, and the file is written while the computation goes on. The
+// snapshot needed next is read in advance into the read buffer with
+// 'prefetch', and 'load' waits for it if needed. A load of a snapshot
+// that is in neither buffer reads its file synchronously, and is
+// counted as a miss.
+template <typename Y>
+class SnapshotStore {
+private:
+    std::size_t                _nslots;
+    std::size_t                _ndisk;
+    std::filesystem::path      _casedir;
+    std::vector<Y>             _ram;
+    std::unique_ptr<Y>         _write_buffer;
+    std::unique_ptr<Y>         _read_buffer;
+    std::size_t                _write_slot;
+    std::size_t                _read_slot;
+    std::size_t                _write_ticket;
+    std::size_t                _read_ticket;
+    std::unique_ptr<TaskQueue> _io;
+
+    static constexpr std::size_t _none = std::numeric_limits<std::size_t>::max();
+
+public:
+    // statistics
+    std::size_t nwrites = 0;
+    std::size_t nreads  = 0;
+    std::size_t nmisses = 0;
+
+    SnapshotStore(const Y&                     y,
+                  std::size_t                  nslots,
+                  std::size_t                  nram,
+                  const std::filesystem::path& casedir)
+        : _nslots(nslots)
+        , _ndisk(nslots - std::min(nram, nslots))
+        , _casedir(casedir)
+        , _ram(nslots - _ndisk, y)
+        , _write_slot(_none)
+        , _read_slot(_none)
+        , _write_ticket(0)
+        , _read_ticket(0) {
+        if (_ndisk > 0) {
+            if (!std::filesystem::is_directory(_casedir))
+                throw std::invalid_argument("invalid directory");
+            _write_buffer = std::make_unique<Y>(y);
+            _read_buffer  = std::make_unique<Y>(y);
+            _io           = std::make_unique<TaskQueue>();
+        }
+    }
+
+    // wait for pending input and output, then remove the files
+    ~SnapshotStore() {
+        if (_io) {
+            try {
+                _io->wait();
+            } catch (...) {
+            }
+            _io.reset();
+            std::error_code ec;
+            for (std::size_t k = 0; k != _ndisk; k++)
+                std::filesystem::remove(filename(k), ec);
+        }
+    }
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    std::size_t size() const { return _nslots; }
+
+    bool on_disk(std::size_t k) const { return k < _ndisk; }
+
+    // name of the file of the k-th slot
+    std::filesystem::path filename(std::size_t k) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "snapshot_%04zu.bin", k);
+        return _casedir / name;
+    }
+
+    // store y in the k-th slot
+    template <typename X>
+    void store(std::size_t k, const X& y) {
+        if (!on_disk(k)) {
+            _ram[k - _ndisk] = y;
+            return;
+        }
+
+        // the buffer is read by the pending write, and the old content
+        // of the slot must not be read in advance
+        _io->wait(_write_ticket);
+        if (_read_slot == k) {
+            _io->wait(_read_ticket);
+            _read_slot = _none;
+        }
+        *_write_buffer = y;
+        _write_slot    = k;
+        _write_ticket  = _io->submit([this, k] { write_binary(filename(k), *_write_buffer); });
+        nwrites++;
+    }
+
+    // start reading the k-th slot, if it is on disk and not buffered
+    void prefetch(std::size_t k) {
+        if (!on_disk(k) || k == _write_slot || k == _read_slot)
+            return;
+
+        // files are written before they are read, as tasks run in order
+        _io->wait(_read_ticket);
+        _read_slot   = k;
+        _read_ticket = _io->submit([this, k] { read_binary(filename(k), *_read_buffer); });
+        nreads++;
+    }
+
+    // copy the k-th slot into y
+    template <typename X>
+    void load(std::size_t k, X& y) {
+        if (!on_disk(k)) {
+            y = _ram[k - _ndisk];
+            return;
+        }
+
+        if (k == _write_slot) {
+            y = *_write_buffer;
+            return;
+        }
+
+        if (k != _read_slot) {
+            prefetch(k);
+            nmisses++;
+        }
+        _io->wait(_read_ticket);
+        y = *_read_buffer;
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Adjoint driver with binomial checkpointing, e.g.
+//
+//      auto rev = Revolve(sys, method, sys_adj, method_adj, stepping, S);
+//      rev(x, l, t_from, t_to);
+//
+// integrating the adjoint variable l backwards from t_to to t_from, along
+// the forward trajectory from x at t_from, without a stage cache of the
+// whole trajectory. The driver keeps at most S snapshots of the state at
+// the beginning of a step, including the initial state, and recomputes
+// the segments between them following the binomial schedule of Griewank,
+// which minimises the number of forward steps for the given memory. Each
+// step is recorded into a buffer of its stages just before the adjoint
+// step over it, so the memory is bounded by S states, plus the registers
+// of the methods and of the stages of one step. For long horizons, only
+// the last R snapshots can be kept in memory, with
+//
+//      auto rev = Revolve(sys, method, sys_adj, method_adj, stepping, S, R, dir);
+//
+// where the others are written to files in the directory dir on a
+// background thread, see SnapshotStore. The snapshot needed once a segment
+// is reversed is read while the segment is recomputed. On exit, x is the state
+// at t_to. The overload taking a callable calls it as
+//
+//      terminal(x, l)
+//
+// as soon as x is known at t_to, before the first adjoint step, e.g. to
+// set l to the gradient of a function of the final state. The number of
+// forward steps of the last call, including the recorded ones, is kept,
+// and their ratio to the number of steps is the recomputation factor.
+// This is 2 - 1/n for n steps if S is at least n, as each step but the
+// last is made once to place the snapshots and once to record its stages,
+// and at most t + 1 for fewer snapshots, with t the smallest number such
+// that the binomial (S + t, S) is at least n. The time stepping must be
+// constant, and methods with a history, e.g. multistep methods, are not
+// supported.
+template <typename SYSTEM, typename METHOD, typename SYSTEM_ADJ, typename METHOD_ADJ>
+class Revolve {
+private:
+    SYSTEM&               _system;
+    METHOD&               _method;
+    SYSTEM_ADJ&           _system_adj;
+    METHOD_ADJ&           _method_adj;
+    TimeStepConstant&     _stepping;
+    std::size_t           _nsnapshots;
+    std::size_t           _nram;
+    std::filesystem::path _casedir;
+
+    std::vector<double> _ts;
+    std::vector<double> _dts;
+
+public:
+    // statistics of the last call
+    std::size_t nsteps       = 0;
+    std::size_t nforward     = 0;
+    std::size_t ndisk_writes = 0;
+    std::size_t ndisk_reads  = 0;
+    std::size_t ndisk_misses = 0;
+
+    Revolve(SYSTEM&               system,
+            METHOD&               method,
+            SYSTEM_ADJ&           system_adj,
+            METHOD_ADJ&           method_adj,
+            TimeStepConstant&     stepping,
+            std::size_t           nsnapshots,
+            std::size_t           nram    = std::numeric_limits<std::size_t>::max(),
+            std::filesystem::path casedir = {})
+        : _system(system)
+        , _method(method)
+        , _system_adj(system_adj)
+        , _method_adj(method_adj)
+        , _stepping(stepping)
+        , _nsnapshots(nsnapshots)
+        , _nram(nram)
+        , _casedir(casedir) {
+        static_assert(!isAdjoint<METHOD>::value, "the first method must be a forward method");
+        static_assert(isAdjoint<METHOD_ADJ>::value, "the second method must be an adjoint method");
+        static_assert(!_has_history_v<METHOD>, "methods with a history are not supported");
+        if (nsnapshots == 0)
+            throw std::invalid_argument("at least one snapshot is needed");
+        if (nram < nsnapshots && !std::filesystem::is_directory(casedir))
+            throw std::invalid_argument("invalid directory");
+    }
+
+    // forward steps per step in the last call
+    double recomputation_factor() const {
+        return nsteps == 0 ? 0.0 : double(nforward) / double(nsteps);
+    }
+
+    template <typename X, typename L>
+    X& operator()(X& x, L& l, double t_from, double t_to) {
+        return (*this)(x, l, t_from, t_to, [](const X&, L&) {});
+    }
+
+    template <typename X, typename L, typename TERMINAL>
+    X& operator()(X& x, L& l, double t_from, double t_to, TERMINAL&& terminal) {
+        if (t_from == t_to)
+            throw std::invalid_argument("time span endpoints must differ");
+
+        using Y = remove_refs_from_coupled_t<X>;
+
+        _ts.clear();
+        _dts.clear();
+        for (auto [t, dt] : TimeRange(t_from, t_to, _stepping.dt)) {
+            _ts.push_back(t);
+            _dts.push_back(dt);
+        }
+        nsteps   = _ts.size();
+        nforward = 0;
+
+        // snapshots, the first holding the initial state
+        SnapshotStore<Y> snapshots(Y(x), std::min(_nsnapshots, nsteps), _nram, _casedir);
+        _StepStages<Y>   stages;
+        Y                y(x);
+        snapshots.store(0, x);
+
+        _reverse(0, nsteps, 0, snapshots, stages, y, x, l, terminal);
+
+        ndisk_writes = snapshots.nwrites;
+        ndisk_reads  = snapshots.nreads;
+        ndisk_misses = snapshots.nmisses;
+        return x;
+    }
+
+private:
+    // advance y from the beginning of step i to that of step j
+    template <typename Y>
+    void _advance(std::size_t i, std::size_t j, Y& y) {
+        for (std::size_t k = i; k != j; k++)
+            step(_method, _system, _ts[k], _dts[k], y, NoOpStageCache<Y>());
+        nforward += j - i;
+    }
+
+    // record step k from the snapshot at the beginning of step i, in the
+    // given slot, then make the adjoint step over it. After the last use
+    // of the slot, the snapshot of the enclosing segment is needed next
+    template <typename Y, typename X, typename L, typename TERMINAL>
+    void _reverse_step(std::size_t       i,
+                       std::size_t       k,
+                       std::size_t       slot,
+                       bool              last,
+                       SnapshotStore<Y>& snapshots,
+                       _StepStages<Y>&   stages,
+                       Y&                y,
+                       X&                x,
+                       L&                l,
+                       TERMINAL&         terminal) {
+        snapshots.load(slot, y);
+        if (last && slot > 0)
+            snapshots.prefetch(slot - 1);
+        _advance(i, k, y);
+        step(_method, _system, _ts[k], _dts[k], y, stages);
+        nforward++;
+        if (k + 1 == nsteps) {
+            x = y;
+            terminal(x, l);
+        }
+        step(_method_adj, _system_adj, _ts[k], _dts[k], l, stages);
+    }
+
+    // reverse steps i to j - 1, with the state at the beginning of step i
+    // in the snapshot 'slot' and the following snapshots free
+    template <typename Y, typename X, typename L, typename TERMINAL>
+    void _reverse(std::size_t       i,
+                  std::size_t       j,
+                  std::size_t       slot,
+                  SnapshotStore<Y>& snapshots,
+                  _StepStages<Y>&   stages,
+                  Y&                y,
+                  X&                x,
+                  L&                l,
+                  TERMINAL&         terminal) {
+        // the snapshot of the enclosing segment is needed next
+        if (slot > 0)
+            snapshots.prefetch(slot - 1);
+
+        const std::size_t nfree = snapshots.size() - 1 - slot;
+        while (j - i > 1) {
+            // without free snapshots, every step is recomputed from the start
+            if (nfree == 0) {
+                for (std::size_t k = j; k-- != i;)
+                    _reverse_step(i, k, slot, k == i, snapshots, stages, y, x, l, terminal);
+                return;
+            }
+
+            // place a snapshot, and reverse the second segment first
+            const std::size_t m = i + _revolve_split(j - i, nfree + 1);
+            snapshots.load(slot, y);
+            _advance(i, m, y);
+            snapshots.store(slot + 1, y);
+            _reverse(m, j, slot + 1, snapshots, stages, y, x, l, terminal);
+            j = m;
+        }
+        _reverse_step(i, i, slot, true, snapshots, stages, y, x, l, terminal);
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Adjoint driver recomputing the forward steps in parallel, e.g.
+//
+//      auto adj = PipelinedAdjoint(sys, method, sys_adj, method_adj, stepping, K, P,
+//                                  [] { return System(Term(), Term()); });
+//      adj(x, l, t_from, t_to);
+//
+// integrating the adjoint variable l backwards from t_to to t_from, as
+// Revolve, with a snapshot of the state every K steps. The last segment of
+// K steps is recorded by the forward sweep, and the others are recomputed
+// from their snapshot by P worker threads, each with a copy of the method
+// and a system of its own, into P + 1 buffers of stages used in turn. The
+// systems of the workers are made by the last argument, called once per
+// worker, and are called concurrently with each other and with sys, so
+// they must own their terms, e.g. a system of temporaries as above, as a
+// system of lvalues refers to the same terms, and scratch space of the
+// terms would be shared. While the
+// adjoint of a segment runs, the P segments before it are recomputed, so
+// the adjoint does not wait when a worker recomputes a segment within P
+// adjoint segments. The number of segments for which it waited, and the
+// time spent waiting, are kept. The memory is bounded by n/K states, for
+// n steps, plus the stages of (P + 1) K steps, and there is one forward
+// step per step besides those of the last segment. The time stepping
+// must be constant, and methods with a history, e.g. multistep methods,
+// are not supported.
+template <typename SYSTEM, typename METHOD, typename SYSTEM_ADJ, typename METHOD_ADJ, typename MAKE_SYSTEM>
+class PipelinedAdjoint {
+private:
+    SYSTEM&           _system;
+    METHOD&           _method;
+    SYSTEM_ADJ&       _system_adj;
+    METHOD_ADJ&       _method_adj;
+    TimeStepConstant& _stepping;
+    std::size_t       _nsegment;
+    std::size_t       _nworkers;
+    MAKE_SYSTEM       _make_system;
+
+    std::vector<double> _ts;
+    std::vector<double> _dts;
+
+public:
+    // statistics of the last call
+    std::size_t nsteps       = 0;
+    std::size_t nforward     = 0;
+    std::size_t nwaits       = 0;
+    double      wait_seconds = 0;
+
+    PipelinedAdjoint(SYSTEM&           system,
+                     METHOD&           method,
+                     SYSTEM_ADJ&       system_adj,
+                     METHOD_ADJ&       method_adj,
+                     TimeStepConstant& stepping,
+                     std::size_t       nsegment,
+                     std::size_t       nworkers,
+                     MAKE_SYSTEM       make_system)
+        : _system(system)
+        , _method(method)
+        , _system_adj(system_adj)
+        , _method_adj(method_adj)
+        , _stepping(stepping)
+        , _nsegment(nsegment)
+        , _nworkers(nworkers)
+        , _make_system(std::move(make_system)) {
+        static_assert(!isAdjoint<METHOD>::value, "the first method must be a forward method");
+        static_assert(isAdjoint<METHOD_ADJ>::value, "the second method must be an adjoint method");
+        static_assert(!_has_history_v<METHOD>, "methods with a history are not supported");
+        if (nsegment == 0)
+            throw std::invalid_argument("segments must have at least one step");
+        if (nworkers == 0)
+            throw std::invalid_argument("at least one worker is needed");
+    }
+
+    // forward steps per step in the last call
+    double recomputation_factor() const {
+        return nsteps == 0 ? 0.0 : double(nforward) / double(nsteps);
+    }
+
+    template <typename X, typename L>
+    X& operator()(X& x, L& l, double t_from, double t_to) {
+        return (*this)(x, l, t_from, t_to, [](const X&, L&) {});
+    }
+
+    template <typename X, typename L, typename TERMINAL>
+    X& operator()(X& x, L& l, double t_from, double t_to, TERMINAL&& terminal) {
+        if (t_from == t_to)
+            throw std::invalid_argument("time span endpoints must differ");
+
+        using Y = remove_refs_from_coupled_t<X>;
+
+        _ts.clear();
+        _dts.clear();
+        for (auto [t, dt] : TimeRange(t_from, t_to, _stepping.dt)) {
+            _ts.push_back(t);
+            _dts.push_back(dt);
+        }
+        nsteps       = _ts.size();
+        nforward     = 0;
+        nwaits       = 0;
+        wait_seconds = 0;
+
+        // segments and their snapshots, the last segment being reversed first
+        const std::size_t K         = _nsegment;
+        const std::size_t nsegments = (nsteps + K - 1) / K;
+        const std::size_t P         = std::min(_nworkers, nsegments - 1);
+        std::vector<Y>    snapshots;
+        snapshots.reserve(nsegments);
+
+        // the stage buffers, then the workers and their registers, so
+        // that the workers are joined before the buffers are released
+        std::vector<std::vector<_StepStages<Y>>> buffers(P + 1, std::vector<_StepStages<Y>>(K));
+        using WORKER_SYSTEM = decltype(_make_system());
+        std::vector<METHOD>                      methods(P, _method);
+        std::vector<WORKER_SYSTEM>               systems;
+        std::vector<Y>                           ys(P, Y(x));
+        std::vector<std::size_t>                 tickets(nsegments, 0);
+        std::vector<std::unique_ptr<TaskQueue>>  workers;
+        systems.reserve(P);
+        for (std::size_t w = 0; w != P; w++) {
+            systems.push_back(_make_system());
+            workers.push_back(std::make_unique<TaskQueue>());
+        }
+
+        // recompute the r-th segment from the end on a worker
+        auto submit = [&](std::size_t r) {
+            const std::size_t s = nsegments - 1 - r;
+            const std::size_t w = r % P;
+            const std::size_t b = r % (P + 1);
+            tickets[r]          = workers[w]->submit([&, s, w, b] {
+                ys[w] = snapshots[s];
+                for (std::size_t k = s * K; k != std::min(s * K + K, nsteps); k++)
+                    step(methods[w], systems[w], _ts[k], _dts[k], ys[w], buffers[b][k - s * K]);
+            });
+            nforward += std::min(s * K + K, nsteps) - s * K;
+        };
+
+        // forward sweep, placing the snapshots, and starting the workers
+        // as soon as the last segment is reached, which is recorded
+        for (std::size_t k = 0; k != nsteps; k++) {
+            if (k % K == 0) {
+                snapshots.push_back(x);
+                if (k / K + 1 == nsegments)
+                    for (std::size_t r = 1; r <= P; r++)
+                        submit(r);
+            }
+            if (k / K + 1 == nsegments) {
+                step(_method, _system, _ts[k], _dts[k], x, buffers[0][k % K]);
+            } else {
+                step(_method, _system, _ts[k], _dts[k], x, NoOpStageCache<Y>());
+            }
+        }
+        nforward += nsteps;
+        terminal(x, l);
+
+        // reverse sweep, the buffer of the segment after the one being
+        // reversed is free for the next segment to recompute
+        for (std::size_t r = 0; r != nsegments; r++) {
+            if (r > 0) {
+                if (r + P < nsegments)
+                    submit(r + P);
+                auto& worker = *workers[r % P];
+                if (!worker.done(tickets[r])) {
+                    const auto start = std::chrono::steady_clock::now();
+                    worker.wait(tickets[r]);
+                    wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    nwaits++;
+                } else {
+                    worker.wait(tickets[r]);
+                }
+            }
+            const std::size_t s = nsegments - 1 - r;
+            auto&             b = buffers[r % (P + 1)];
+            for (std::size_t k = std::min(s * K + K, nsteps); k-- != s * K;)
+                step(_method_adj, _system_adj, _ts[k], _dts[k], l, b[k - s * K]);
+        }
+        return x;
+    }
+};
+}
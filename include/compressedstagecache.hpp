@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+#include "coupled.hpp"
+#include "stagecache.hpp"
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Visit the contiguous blocks of doubles of an object, calling f(p, n)
+// with a pointer p to n elements, in a fixed order. Objects with the
+// same sizes have the same blocks.
+template <typename F>
+inline void _for_each_block(double& x, F&& f) { f(&x, std::size_t(1)); }
+
+template <typename F>
+inline void _for_each_block(const double& x, F&& f) { f(&x, std::size_t(1)); }
+
+template <typename F>
+inline void _for_each_block(std::valarray<double>& x, F&& f) {
+    if (x.size() > 0)
+        f(&x[0], x.size());
+}
+
+template <typename F>
+inline void _for_each_block(const std::valarray<double>& x, F&& f) {
+    if (x.size() > 0)
+        f(&x[0], x.size());
+}
+
+template <typename F>
+inline void _for_each_block(std::vector<double>& x, F&& f) {
+    if (x.size() > 0)
+        f(x.data(), x.size());
+}
+
+template <typename F>
+inline void _for_each_block(const std::vector<double>& x, F&& f) {
+    if (x.size() > 0)
+        f(x.data(), x.size());
+}
+
+template <typename... Ts, typename F>
+inline void _for_each_block(Coupled<Ts...>& x, F&& f) {
+    std::apply([&](auto&... xs) { (_for_each_block(xs, f), ...); }, x._elems);
+}
+
+template <typename... Ts, typename F>
+inline void _for_each_block(const Coupled<Ts...>& x, F&& f) {
+    std::apply([&](const auto&... xs) { (_for_each_block(xs, f), ...); }, x._elems);
+}
+
+////////////////////////////////////////////////////////////////
+// CODECS. A codec appends the encoding of n doubles to a buffer with
+//
+//      encode(x, n, out)
+//
+// and decodes them with
+//
+//      in = decode(in, x, n)
+//
+// returning the end of the encoding. The number n is not encoded, as
+// all stages of a cache have the same blocks.
+
+// Store doubles as floats, with a relative error of about 6e-8, for
+// values in the range of floats.
+struct FloatCodec {
+    void encode(const double* x, std::size_t n, std::vector<std::uint8_t>& out) {
+        const std::size_t at = out.size();
+        out.resize(at + n * sizeof(float));
+        for (std::size_t i = 0; i != n; i++) {
+            const float f = float(x[i]);
+            std::memcpy(out.data() + at + i * sizeof(float), &f, sizeof(float));
+        }
+    }
+
+    const std::uint8_t* decode(const std::uint8_t* in, double* x, std::size_t n) {
+        for (std::size_t i = 0; i != n; i++) {
+            float f;
+            std::memcpy(&f, in + i * sizeof(float), sizeof(float));
+            x[i] = f;
+        }
+        return in + n * sizeof(float);
+    }
+};
+
+// Lossless codec. The bytes of the doubles are first shuffled, with the
+// k-th bytes of all values stored together, so that sign, exponent and
+// leading mantissa bytes, which vary slowly across a smooth field, form
+// long runs. These are then compressed with a byte oriented LZ77 codec in
+// the style of LZ4, with a sequence of tokens
+//
+//      [literal length | match length - 4] [literals] [offset]
+//
+// where lengths of 15 or more continue in the following bytes, offsets
+// take two bytes, and the last sequence has literals only.
+class ShuffleLZCodec {
+private:
+    static constexpr std::size_t _hash_bits  = 12;
+    static constexpr std::size_t _min_match  = 4;
+    static constexpr std::size_t _max_offset = 65535;
+
+    std::vector<std::uint8_t>  _bytes;
+    std::vector<std::uint32_t> _table;
+
+    static std::uint32_t _read32(const std::uint8_t* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::size_t _hash(std::uint32_t v) {
+        return (v * 2654435761u) >> (32 - _hash_bits);
+    }
+
+    static void _put_length(std::size_t len, std::vector<std::uint8_t>& out) {
+        for (; len >= 255; len -= 255)
+            out.push_back(255);
+        out.push_back(std::uint8_t(len));
+    }
+
+    static std::size_t _get_length(std::size_t len, const std::uint8_t*& in) {
+        if (len == 15) {
+            std::uint8_t b;
+            do {
+                b = *in++;
+                len += b;
+            } while (b == 255);
+        }
+        return len;
+    }
+
+    // append a sequence of literals, followed by a match if len > 0
+    static void _put_sequence(const std::uint8_t*        literals,
+                              std::size_t                nliterals,
+                              std::size_t                offset,
+                              std::size_t                len,
+                              std::vector<std::uint8_t>& out) {
+        const std::size_t l = nliterals < 15 ? nliterals : 15;
+        const std::size_t m = len == 0 ? 0 : (len - _min_match < 15 ? len - _min_match : 15);
+        out.push_back(std::uint8_t((l << 4) | m));
+        if (l == 15)
+            _put_length(nliterals - 15, out);
+        out.insert(out.end(), literals, literals + nliterals);
+        if (len > 0) {
+            out.push_back(std::uint8_t(offset & 0xff));
+            out.push_back(std::uint8_t(offset >> 8));
+            if (m == 15)
+                _put_length(len - _min_match - 15, out);
+        }
+    }
+
+public:
+    ShuffleLZCodec()
+        : _table(std::size_t(1) << _hash_bits) {}
+
+    // compress n bytes
+    void compress(const std::uint8_t* src, std::size_t n, std::vector<std::uint8_t>& out) {
+        std::fill(_table.begin(), _table.end(), std::uint32_t(-1));
+        std::size_t anchor = 0;
+        std::size_t i      = 0;
+        while (i + _min_match <= n) {
+            const std::uint32_t v    = _read32(src + i);
+            const std::size_t   h    = _hash(v);
+            const std::size_t   cand = _table[h];
+            _table[h]                = std::uint32_t(i);
+            if (cand != std::uint32_t(-1) && i - cand <= _max_offset && _read32(src + cand) == v) {
+                std::size_t len = _min_match;
+                while (i + len < n && src[cand + len] == src[i + len])
+                    len++;
+                _put_sequence(src + anchor, i - anchor, i - cand, len, out);
+                i += len;
+                anchor = i;
+            } else {
+                i++;
+            }
+        }
+        _put_sequence(src + anchor, n - anchor, 0, 0, out);
+    }
+
+    // decompress n bytes, returning the end of the input
+    static const std::uint8_t* decompress(const std::uint8_t* in, std::uint8_t* dst, std::size_t n) {
+        std::size_t o = 0;
+        while (true) {
+            const std::uint8_t token     = *in++;
+            const std::size_t  nliterals = _get_length(token >> 4, in);
+            std::memcpy(dst + o, in, nliterals);
+            in += nliterals;
+            o += nliterals;
+            if (o >= n)
+                return in;
+
+            const std::size_t offset = std::size_t(in[0]) | (std::size_t(in[1]) << 8);
+            in += 2;
+            const std::size_t len = _get_length(token & 0x0f, in) + _min_match;
+
+            // matches may overlap with their output
+            for (std::size_t k = 0; k != len; k++, o++)
+                dst[o] = dst[o - offset];
+        }
+    }
+
+    void encode(const double* x, std::size_t n, std::vector<std::uint8_t>& out) {
+        const std::size_t nbytes = n * sizeof(double);
+        _bytes.resize(nbytes);
+        const auto* src = reinterpret_cast<const std::uint8_t*>(x);
+        for (std::size_t i = 0; i != n; i++)
+            for (std::size_t b = 0; b != sizeof(double); b++)
+                _bytes[b * n + i] = src[i * sizeof(double) + b];
+        compress(_bytes.data(), nbytes, out);
+    }
+
+    const std::uint8_t* decode(const std::uint8_t* in, double* x, std::size_t n) {
+        _bytes.resize(n * sizeof(double));
+        in        = decompress(in, _bytes.data(), _bytes.size());
+        auto* dst = reinterpret_cast<std::uint8_t*>(x);
+        for (std::size_t i = 0; i != n; i++)
+            for (std::size_t b = 0; b != sizeof(double); b++)
+                dst[i * sizeof(double) + b] = _bytes[b * n + i];
+        return in;
+    }
+};
+
+// Error bounded codec, where the values are rounded to the nearest
+// multiple of 2*tolerance, so that the absolute error is at most the
+// tolerance. The differences of consecutive multiples are stored as
+// variable length integers, which take few bytes for smooth fields.
+// The values must be finite, and smaller than 2^62 tolerances.
+class QuantizerCodec {
+private:
+    double _tolerance;
+
+public:
+    QuantizerCodec(double tolerance)
+        : _tolerance(tolerance) {
+        if (!(tolerance > 0))
+            throw std::invalid_argument("the tolerance must be positive");
+    }
+
+    double tolerance() const { return _tolerance; }
+
+    void encode(const double* x, std::size_t n, std::vector<std::uint8_t>& out) {
+        std::int64_t prev = 0;
+        for (std::size_t i = 0; i != n; i++) {
+            const std::int64_t q = std::llround(x[i] / (2 * _tolerance));
+            const std::int64_t d = q - prev;
+            prev                 = q;
+
+            // zigzag encoding, then seven bits per byte
+            std::uint64_t u = (std::uint64_t(d) << 1) ^ std::uint64_t(d >> 63);
+            for (; u >= 0x80; u >>= 7)
+                out.push_back(std::uint8_t(u | 0x80));
+            out.push_back(std::uint8_t(u));
+        }
+    }
+
+    const std::uint8_t* decode(const std::uint8_t* in, double* x, std::size_t n) {
+        std::int64_t prev = 0;
+        for (std::size_t i = 0; i != n; i++) {
+            std::uint64_t u     = 0;
+            unsigned      shift = 0;
+            std::uint8_t  b;
+            do {
+                b = *in++;
+                u |= std::uint64_t(b & 0x7f) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            prev += std::int64_t(u >> 1) ^ -std::int64_t(u & 1);
+            x[i] = prev * (2 * _tolerance);
+        }
+        return in;
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Indexable sequence of compressed stages, used by the views of
+// CompressedStageCache. Stages are decoded on demand into a ring of
+// one register for each of the N stages of a step, as adjoint steps
+// use one stage at a time.
+template <typename X, std::size_t N, typename CODEC>
+class _CompressedStages {
+private:
+    mutable CODEC                         _codec;
+    std::vector<std::uint8_t>             _data;
+    std::vector<std::size_t>              _offsets;
+    mutable std::vector<X>                _registers;
+    std::size_t                           _nraw     = 0;
+    mutable std::size_t                   _ndecoded = 0;
+    mutable std::chrono::duration<double> _decode_time{ 0 };
+
+public:
+    template <typename... ARGS>
+    _CompressedStages(ARGS&&... args)
+        : _codec(std::forward<ARGS>(args)...) {}
+
+    void push_back(const X& x) {
+        // the registers take the sizes of the stages
+        if (_registers.empty())
+            _registers.assign(N, x);
+        _offsets.push_back(_data.size());
+        _for_each_block(x, [&](const double* p, std::size_t n) {
+            _codec.encode(p, n, _data);
+            _nraw += n * sizeof(double);
+        });
+    }
+
+    const X& operator[](std::size_t i) const {
+        const auto          start = std::chrono::steady_clock::now();
+        auto&               reg   = _registers[i % N];
+        const std::uint8_t* in = _data.data() + _offsets[i];
+        _for_each_block(reg, [&](double* p, std::size_t n) {
+            in = _codec.decode(in, p, n);
+            _ndecoded += n * sizeof(double);
+        });
+        _decode_time += std::chrono::steady_clock::now() - start;
+        return reg;
+    }
+
+    std::size_t raw_bytes() const { return _nraw; }
+    std::size_t bytes() const { return _data.size(); }
+    std::size_t decoded_bytes() const { return _ndecoded; }
+    double      decode_seconds() const { return _decode_time.count(); }
+};
+
+////////////////////////////////////////////////////////////////
+// COMPRESSED RAM STAGE CACHE, e.g.
+//
+//      auto cache = CompressedStageCache<X, N, FloatCodec>();
+//      auto cache = CompressedStageCache<X, N, QuantizerCodec>(1e-8);
+//
+// where the arguments are passed to the constructor of the codec. Each
+// stage is encoded when pushed, one contiguous block of doubles at a
+// time, see _for_each_block, and is decoded when read by the adjoint
+// step. FloatCodec halves the memory, ShuffleLZCodec is lossless, and
+// QuantizerCodec bounds the absolute error. The stages are decoded into
+// N registers, so only one step of stages is kept in full. Lossy codecs
+// perturb the linearisation point of the adjoint, which is often
+// acceptable, e.g. for sensitivities of chaotic flows.
+template <typename X, std::size_t N, typename CODEC = FloatCodec>
+class CompressedStageCache : public AbstractStageCache<X, N> {
+private:
+    _CompressedStages<X, N, CODEC> _xs;
+    std::vector<double>            _ts;
+    std::vector<double>            _dts;
+
+public:
+    template <typename... ARGS>
+    CompressedStageCache(ARGS&&... args)
+        : _xs(std::forward<ARGS>(args)...) {}
+
+    // this prepares storage space for a new step
+    void setup_step(double t, double dt) override {
+        _ts.push_back(t);
+        _dts.push_back(dt);
+    }
+
+    // encode a stage vector into the cache
+    void push_back(const X& x) override { _xs.push_back(x); }
+
+    // end-of-step function
+    void close_step() override{ /* does nothing */ };
+
+    // memory of the encoded stages, in bytes
+    std::size_t bytes() const { return _xs.bytes(); }
+
+    // size of the stages over the size of their encoding
+    double compression_ratio() const {
+        return _xs.bytes() == 0 ? 0.0 : double(_xs.raw_bytes()) / double(_xs.bytes());
+    }
+
+    // decoded bytes per second, over all reads of the stages
+    double decode_throughput() const {
+        return _xs.decode_seconds() == 0 ? 0.0 : _xs.decoded_bytes() / _xs.decode_seconds();
+    }
+
+    // indexing (mainly for testing code)
+    auto operator[](std::size_t i) {
+        return std::make_tuple(_ts[i], _dts[i], View<_CompressedStages<X, N, CODEC>, N>(_xs, i * N));
+    }
+
+    // iteration support
+    auto begin() const {
+        return StageIterator<std::vector<double>, _CompressedStages<X, N, CODEC>, N>(_ts, _dts, _xs, 0);
+    }
+    auto end() const {
+        return StageIterator<std::vector<double>, _CompressedStages<X, N, CODEC>, N>(_ts, _dts, _xs, _ts.size());
+    }
+};
+}
@@ -1,16 +1,20 @@
 #pragma once
+#include <array>
+#include <cmath>
 #include <cstddef>
 #include <iostream>
+#include <tuple>
 #include <type_traits>
 #include <utility>
+#include <valarray>
+
+#include "threads.hpp"
 
 namespace Flows {
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // All objects will inherit from this, in order ot avoid polluting the namespace
 // and avoiding catch all situations that you end up with using expression templates.
-// We will probably never have Pair and Triplet together, so we only define
-// one object.
 
 template <typename E>
 struct CoupledExpr {
@@ -22,11 +26,8 @@ struct CoupledExpr {
 //////////////////////////////////////////////////////////////////////////////////////////
 // Forward declarations
 
-template <typename A, typename B>
-struct Pair;
-
-template <typename A, typename B, typename C>
-struct Triplet;
+template <typename... Ts>
+struct Coupled;
 
 template <typename ARG, typename S>
 struct CoupledAdd;
@@ -39,54 +40,31 @@ struct CoupledMul;
 
 template <typename ARG, typename S>
 struct CoupledDiv;
+
+struct _Zero;
+
+// The two most common cases have their own names
+template <typename A, typename B>
+using Pair = Coupled<A, B>;
+
+template <typename A, typename B, typename C>
+using Triplet = Coupled<A, B, C>;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // Argument getters. These behave similarly to std::get for tuples.
 namespace std {
 #define DEFINE_GETTER(_Modifier)                                                \
-    template <std::size_t N, typename A, typename B>                            \
-    _Modifier auto& get(_Modifier Flows::Pair<A, B>& j) {                       \
-        static_assert(N == 0 || N == 1, "invalid template argument");           \
-        if constexpr (N == 0) {                                                 \
-            return j.a;                                                         \
-        } else {                                                                \
-            return j.b;                                                         \
-        }                                                                       \
-    }                                                                           \
-                                                                                \
-    template <std::size_t N, typename A, typename B, typename C>                \
-    _Modifier auto& get(_Modifier Flows::Triplet<A, B, C>& j) {                 \
-        static_assert(N == 0 || N == 1 || N == 2, "invalid template argument"); \
-        if constexpr (N == 0) {                                                 \
-            return j.a;                                                         \
-        } else if constexpr (N == 1) {                                          \
-            return j.b;                                                         \
-        } else if constexpr (N == 2) {                                          \
-            return j.c;                                                         \
-        }                                                                       \
-    }                                                                           \
-                                                                                \
-    template <std::size_t N, typename I, typename A, typename B>                \
-    _Modifier auto& get(_Modifier Flows::Pair<A, B>& j, I i) {                  \
-        static_assert(N == 0 || N == 1, "invalid template argument");           \
-        if constexpr (N == 0) {                                                 \
-            return j.a[i];                                                      \
-        } else {                                                                \
-            return j.b[i];                                                      \
-        }                                                                       \
+    template <std::size_t N, typename... Ts>                                    \
+    _Modifier auto& get(_Modifier Flows::Coupled<Ts...>& j) {                   \
+        static_assert(N < sizeof...(Ts), "invalid template argument");         \
+        return std::get<N>(j._elems);                                           \
     }                                                                           \
                                                                                 \
-    template <std::size_t N, typename I, typename A, typename B, typename C>    \
-    _Modifier auto& get(_Modifier Flows::Triplet<A, B, C>& j, I i) {            \
-        static_assert(N == 0 || N == 1 || N == 2, "invalid template argument"); \
-        if constexpr (N == 0) {                                                 \
-            return j.a[i];                                                      \
-        } else if constexpr (N == 1) {                                          \
-            return j.b[i];                                                      \
-        } else if constexpr (N == 2) {                                          \
-            return j.c[i];                                                      \
-        }                                                                       \
+    template <std::size_t N, typename I, typename... Ts>                        \
+    _Modifier auto& get(_Modifier Flows::Coupled<Ts...>& j, I i) {              \
+        static_assert(N < sizeof...(Ts), "invalid template argument");         \
+        return std::get<N>(j._elems)[i];                                        \
     }
 
 DEFINE_GETTER()
@@ -104,7 +82,7 @@ DEFINE_GETTER(const)
     };                                                 \
                                                        \
     template <std::size_t n, typename ARG, typename S> \
-    inline auto get(const _Name<ARG, S>& v, int i) {   \
+    inline auto get(const _Name<ARG, S>& v, size_t i) {\
         return get<n>(v.arg, i) _Op v.s;               \
     };
 
@@ -119,21 +97,32 @@ _DEFINE_MULDIV_OPERATOR(/, Flows::CoupledDiv)
     }                                                   \
                                                         \
     template <std::size_t n, typename ARG, typename S>  \
-    inline auto get(const _Name<ARG, S>& v, int i) {    \
+    inline auto get(const _Name<ARG, S>& v, size_t i) { \
         return get<n>(v.arg1, i) _Op get<n>(v.arg2, i); \
     }
 
 _DEFINE_ADDSUB_OPERATOR(+, Flows::CoupledAdd)
 _DEFINE_ADDSUB_OPERATOR(-, Flows::CoupledSub)
 #undef _DEFINE_ADDSUB_OPERATOR
+
+// all components of a compile-time zero are zero
+template <std::size_t n>
+inline double get(const Flows::_Zero&) {
+    return 0;
+}
+
+template <std::size_t n>
+inline double get(const Flows::_Zero&, size_t) {
+    return 0;
+}
 }
 
 namespace Flows {
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Now define the objects used for the expression templates using Pair structs. We
-// define * and / of Pair and Triplet objects with arithmetic types only, i.e. we model
-// a vector space. Note that we allow division by a Pair or Triplet, because this
+// Now define the objects used for the expression templates using Coupled structs. We
+// define * and / of Coupled objects with arithmetic types only, i.e. we model
+// a vector space. Note that we allow division by a Coupled object, because this
 // leads to a shorter code and it is not to be used in user code
 #define _DEFINE_MULDIV_OPERATOR(_Op, _Name)                 \
                                                             \
@@ -166,7 +155,7 @@ _DEFINE_MULDIV_OPERATOR(/, CoupledDiv)
 #undef _DEFINE_MULDIV_OPERATOR
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Define Addition and Division for Pair object
+// Define Addition and Division for Coupled objects
 #define _DEFINE_ADDSUB_OPERATOR(_Op, _Name)                                      \
                                                                                  \
     template <typename ARG1, typename ARG2>                                      \
@@ -190,6 +179,214 @@ _DEFINE_ADDSUB_OPERATOR(-, CoupledSub)
 
 #undef _DEFINE_ADDSUB_OPERATOR
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Terms with coefficients known at compile time to be zero. Time stepping methods
+// build their stage updates with _scaled<c != 0>(c * dt, x), which returns either
+// the product or a _Zero object, and _Zero drops out of sums, so that e.g.
+// x + _scaled<false>(c, y) is just x and produces no loop over y. This works for
+// coupled objects as well as for arithmetic types and std::valarray. A sum made only
+// of zeros is a _Zero, which can be assigned to set the target to zero.
+struct _Zero {
+    constexpr operator double() const { return 0; }
+    constexpr double operator[](std::size_t) const { return 0; }
+};
+
+template <typename T>
+inline const T& operator+(const T& x, _Zero) { return x; }
+
+template <typename T>
+inline const T& operator+(_Zero, const T& x) { return x; }
+
+inline _Zero operator+(_Zero, _Zero) { return {}; }
+
+// Note that both arguments are taken by reference, because std::valarray
+// expressions store references to their scalar operands.
+template <bool NONZERO, typename S, typename X>
+inline auto _scaled(const S& c, const X& x) {
+    if constexpr (NONZERO) {
+        return c * x;
+    } else {
+        return _Zero();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Fast path for components with contiguous storage. Before looping over the n-th
+// component we "bind" the expression, i.e. we build a copy of the expression tree
+// where every Coupled leaf is replaced by a raw pointer to the data of its
+// n-th component. The bound tree is copied into the kernel by value, so the compiler
+// knows that neither its pointers nor its scalars are modified by the stores, and is
+// evaluated with a 64-bit index in a loop that the compiler vectorizes for whatever
+// instruction set is enabled (SSE2, AVX2 or AVX-512), with its own scalar tail.
+// Components that do not expose contiguous storage, or expressions that cannot be
+// bound, use the generic path.
+
+// Tell the compiler that there are no loop-carried dependencies. The only aliasing
+// allowed between the output and the operands is the exact one, e.g. in x = x + dt*k,
+// where element i of x is read before being written.
+#if defined(__clang__)
+#define _FLOWS_IVDEP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define _FLOWS_IVDEP _Pragma("GCC ivdep")
+#else
+#define _FLOWS_IVDEP
+#endif
+
+// pointer to the contiguous storage of a component. Note that std::valarray does
+// not have a data() member, but its elements are guaranteed to be contiguous
+template <typename T>
+inline T* _data(std::valarray<T>& x) { return std::begin(x); }
+
+template <typename T>
+inline const T* _data(const std::valarray<T>& x) { return std::begin(x); }
+
+template <typename T>
+inline auto _data(T& x) -> decltype(x.data()) { return x.data(); }
+
+// checks whether T exposes contiguous storage of an arithmetic type
+template <typename T, typename = void>
+struct _is_contiguous : std::false_type {};
+
+template <typename T>
+struct _is_contiguous<T,
+    std::void_t<decltype(_data(std::declval<T&>())), decltype(std::declval<T&>().size())>> {
+    using P = decltype(_data(std::declval<T&>()));
+    constexpr static bool value = std::is_pointer_v<P>
+        && std::is_arithmetic_v<std::remove_cv_t<std::remove_pointer_t<P>>>;
+};
+
+template <typename T>
+inline constexpr static bool _is_contiguous_v = _is_contiguous<std::remove_reference_t<T>>::value;
+
+// element type of a contiguous component
+template <typename T>
+using _elem_t = std::remove_cv_t<std::remove_pointer_t<decltype(_data(std::declval<T&>()))>>;
+
+// Nodes of the bound expression tree. They mirror the CoupledExpr objects above.
+template <typename T>
+struct _BoundLeaf {
+    const T* ptr;
+    inline T operator[](std::size_t i) const { return ptr[i]; }
+};
+
+template <typename T>
+struct _BoundScalar {
+    T val;
+    inline T operator[](std::size_t) const { return val; }
+};
+
+#define _DEFINE_BOUND_MULDIV(_Op, _Name)                    \
+    template <typename B, typename S>                       \
+    struct _Name {                                          \
+        B arg;                                              \
+        S s;                                                \
+        inline auto operator[](std::size_t i) const {       \
+            return arg[i] _Op s;                            \
+        }                                                   \
+    };
+
+_DEFINE_BOUND_MULDIV(*, _BoundMul)
+_DEFINE_BOUND_MULDIV(/, _BoundDiv)
+#undef _DEFINE_BOUND_MULDIV
+
+#define _DEFINE_BOUND_ADDSUB(_Op, _Name)                    \
+    template <typename B1, typename B2>                     \
+    struct _Name {                                          \
+        B1 arg1;                                            \
+        B2 arg2;                                            \
+        inline auto operator[](std::size_t i) const {       \
+            return arg1[i] _Op arg2[i];                     \
+        }                                                   \
+    };
+
+_DEFINE_BOUND_ADDSUB(+, _BoundAdd)
+_DEFINE_BOUND_ADDSUB(-, _BoundSub)
+#undef _DEFINE_BOUND_ADDSUB
+
+// Bind the n-th component of an expression. The primary template is used for
+// expressions that cannot be bound, and does not define the 'bind' function.
+template <std::size_t n, typename E, typename = void>
+struct _Binder {};
+
+// checks whether the n-th component of an expression can be bound
+template <std::size_t n, typename E, typename = void>
+struct _is_bindable : std::false_type {};
+
+template <std::size_t n, typename E>
+struct _is_bindable<n, E, std::void_t<decltype(&_Binder<n, E>::bind)>> : std::true_type {};
+
+template <std::size_t n, typename E>
+inline auto _bind(const E& expr) {
+    return _Binder<n, E>::bind(expr);
+}
+
+// type of the n-th component of a Coupled object
+template <std::size_t n, typename S>
+using _component_t = std::remove_reference_t<decltype(std::get<n>(std::declval<const S&>()))>;
+
+// leaves are replaced by a pointer to their data
+template <std::size_t n, typename... Ts>
+struct _Binder<n, Coupled<Ts...>, std::enable_if_t<_is_contiguous_v<_component_t<n, Coupled<Ts...>>>>> {
+    static inline auto bind(const Coupled<Ts...>& v) {
+        return _BoundLeaf<_elem_t<_component_t<n, Coupled<Ts...>>>>{ _data(std::get<n>(v)) };
+    }
+};
+
+#define _DEFINE_BINDER_MULDIV(_Name, _Bound)                                                     \
+    template <std::size_t n, typename ARG, typename S>                                           \
+    struct _Binder<n, _Name<ARG, S>, std::enable_if_t<_is_bindable<n, ARG>::value>> {            \
+        static inline auto bind(const _Name<ARG, S>& v) {                                        \
+            return _Bound<decltype(_bind<n>(v.arg)), S>{ _bind<n>(v.arg), v.s };                 \
+        }                                                                                         \
+    };
+
+_DEFINE_BINDER_MULDIV(CoupledMul, _BoundMul)
+_DEFINE_BINDER_MULDIV(CoupledDiv, _BoundDiv)
+#undef _DEFINE_BINDER_MULDIV
+
+#define _DEFINE_BINDER_ADDSUB(_Name, _Bound)                                                     \
+    template <std::size_t n, typename ARG1, typename ARG2>                                       \
+    struct _Binder<n, _Name<ARG1, ARG2>,                                                         \
+        std::enable_if_t<_is_bindable<n, ARG1>::value && _is_bindable<n, ARG2>::value>> {        \
+        static inline auto bind(const _Name<ARG1, ARG2>& v) {                                    \
+            using B1 = decltype(_bind<n>(v.arg1));                                                \
+            using B2 = decltype(_bind<n>(v.arg2));                                                \
+            return _Bound<B1, B2>{ _bind<n>(v.arg1), _bind<n>(v.arg2) };                          \
+        }                                                                                         \
+    };
+
+_DEFINE_BINDER_ADDSUB(CoupledAdd, _BoundAdd)
+_DEFINE_BINDER_ADDSUB(CoupledSub, _BoundSub)
+#undef _DEFINE_BINDER_ADDSUB
+
+template <std::size_t n>
+struct _Binder<n, _Zero> {
+    static inline auto bind(const _Zero&) {
+        return _BoundScalar<double>{ 0 };
+    }
+};
+
+// Evaluate a bound expression into dst[begin:end]. Note that blocking the loop by
+// hand into fixed-width groups of lanes is slower, because the compiler then falls
+// back to straight-line vectorization of each block instead of vectorizing the loop.
+template <typename T, typename BOUND>
+inline void _kernel(T* dst, const BOUND expr, std::size_t begin, std::size_t end) {
+    _FLOWS_IVDEP
+    for (std::size_t i = begin; i < end; i++)
+        dst[i] = expr[i];
+}
+
+// Evaluate a bound expression into dst[0:size]. Large components are split
+// across the threads of the global pool, see threads.hpp, with chunks aligned
+// to cache lines, so that threads do not write to the same line.
+template <typename T, typename BOUND>
+inline void _kernel(T* dst, const BOUND& expr, std::size_t size) {
+    constexpr std::size_t ALIGN = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+    _parallel_for(size, ALIGN, [&](std::size_t begin, std::size_t end) {
+        _kernel(dst, expr, begin, end);
+    });
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Assignment functions. These are used in the overload of the copy assignment operator
 
@@ -200,16 +397,20 @@ template <
     typename T,
     typename std::enable_if<std::is_arithmetic_v<T>, int>::type = 0>
 inline void _assign(S& s, const T& val) {
-    // we might be storing a number as a field of the Pair object
+    // we might be storing a number as a field of the Coupled object
     // so we just want this to be a single operation
     // check if the type returned by get<n>(s) is an arithmetic or not
     using Ts = std::remove_reference_t<decltype(std::get<n>(s))>;
     if constexpr (std::is_arithmetic_v<Ts>) {
         std::get<n>(s) = val;
+    } else if constexpr (_is_contiguous_v<Ts>) {
+        // fast path for contiguous storage
+        using T_elem = _elem_t<Ts>;
+        _kernel(_data(std::get<n>(s)), _BoundScalar<T_elem>{ T_elem(val) }, std::get<n>(s).size());
     } else {
-        // this cover the case where we are setting a Pair object
+        // this cover the case where we are setting a Coupled object
         // to a number, e.g. to set all fields to zero
-        for (auto i = 0; i != std::get<n>(s).size(); i++)
+        for (std::size_t i = 0, size = std::get<n>(s).size(); i != size; i++)
             std::get<n>(s, i) = val;
     }
 }
@@ -225,104 +426,461 @@ inline void _assign(S& s, const CoupledExpr<E>& _expr) {
     using Ts = std::remove_reference_t<decltype(std::get<n>(s))>;
     if constexpr (std::is_arithmetic_v<Ts>) {
         std::get<n>(s) = std::get<n>(expr);
+    } else if constexpr (_is_contiguous_v<Ts> && _is_bindable<n, E>::value) {
+        // fast path for contiguous storage
+        _kernel(_data(std::get<n>(s)), _bind<n>(expr), std::get<n>(s).size());
     } else {
-        for (auto i = 0; i != std::get<n>(s).size(); i++)
+        for (std::size_t i = 0, size = std::get<n>(s).size(); i != size; i++)
             std::get<n>(s, i) = std::get<n>(expr, i);
     }
 }
 
+// from a compile-time zero
+template <std::size_t n, typename S>
+inline void _assign(S& s, _Zero) {
+    _assign<n>(s, 0.0);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
-// Definitions of the two objects
+// Definition of the coupled object, holding any number of components
 
-template <typename A, typename B>
-struct Pair : public CoupledExpr<Pair<A, B>> {
-    A a;
-    B b;
-
-    // constructor from the three elements
-    Pair(A&& _a, B&& _b)
-        : a(std::forward<A>(_a))
-        , b(std::forward<B>(_b)) {
+template <typename... Ts>
+struct Coupled : public CoupledExpr<Coupled<Ts...>> {
+    std::tuple<Ts...> _elems;
+
+    // constructor from the elements
+    Coupled(Ts&&... xs)
+        : _elems(std::forward<Ts>(xs)...) {
     }
 
-    // define copy constrcutor so we can instantiate an array of Pair objects
-    Pair(const Pair<A, B>& ab)
-        : a(ab.a)
-        , b(ab.b) {
+    // define copy constrcutor so we can instantiate an array of Coupled objects
+    Coupled(const Coupled<Ts...>& other)
+        : _elems(other._elems) {
     }
 
-    template <typename E>
-    inline Pair<A, B>& operator=(const E& val) {
-        _assign<0>(*this, val);
-        _assign<1>(*this, val);
-        return *this;
+    // move constructor, so that arrays of Coupled objects move their
+    // components, e.g. their buffers, when they grow
+    Coupled(Coupled<Ts...>&& other) noexcept(std::is_nothrow_move_constructible_v<std::tuple<Ts...>>)
+        : _elems(std::move(other._elems)) {
     }
-};
 
-template <typename A, typename B, typename C>
-struct Triplet : public CoupledExpr<Triplet<A, B, C>> {
-    A a;
-    B b;
-    C c;
-
-    // constructor from the three elements
-    Triplet(A&& _a, B&& _b, C&& _c)
-        : a(std::forward<A>(_a))
-        , b(std::forward<B>(_b))
-        , c(std::forward<C>(_c)) {
+    // copy and move assignment, which are not implicitly declared with a
+    // move constructor
+    Coupled<Ts...>& operator=(const Coupled<Ts...>& other) {
+        _elems = other._elems;
+        return *this;
     }
 
-    // define copy constrcutor so we can instantiate an array of Triplet objects
-    Triplet(const Triplet<A, B, C>& abc)
-        : a(abc.a)
-        , b(abc.b)
-        , c(abc.c) {
+    Coupled<Ts...>& operator=(Coupled<Ts...>&& other) noexcept(std::is_nothrow_move_assignable_v<std::tuple<Ts...>>) {
+        _elems = std::move(other._elems);
+        return *this;
     }
 
+    // assign all components, with a fold over the component indices
     template <typename E>
-    inline Triplet<A, B, C>& operator=(const E& val) {
-        _assign<0>(*this, val);
-        _assign<1>(*this, val);
-        _assign<2>(*this, val);
+    inline Coupled<Ts...>& operator=(const E& val) {
+        _assign_components(val, std::index_sequence_for<Ts...>());
         return *this;
     }
+
+private:
+    template <typename E, std::size_t... Is>
+    inline void _assign_components(const E& val, std::index_sequence<Is...>) {
+        (_assign<Is>(*this, val), ...);
+    }
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////
 // These are the two main functions to be used.
 //
-// This takes two objects by reference and is used when we want
+// This takes objects by reference and is used when we want
 // these objects to be modified in place and packed in a lightweight
 // wrapper object, for instance for forward integration
-template <typename A, typename B>
-Pair<A&, B&> refcouple(A& a, B& b) {
-    return { a, b };
-}
-
-template <typename A, typename B, typename C>
-Triplet<A&, B&, C&> refcouple(A& a, B& b, C& c) {
-    return { a, b, c };
+template <typename... Ts>
+Coupled<Ts&...> refcouple(Ts&... xs) {
+    return { xs... };
 }
 
-// This one takes two objects by value. If they are lvalues, we make
+// This one takes objects by value. If they are lvalues, we make
 // copies at the call site and then move them to a new object. If they
 // are rvalues, the compiler will call the move constructor to create
 // the input arguments from the rvalues and then we wimply move these
-// objects into the Pair or Triplet. This function is used to create
-// a new Pair object with independent inner members, and is primarily
+// objects into the Coupled object. This function is used to create
+// a new Coupled object with independent inner members, and is primarily
 // used to create appropriate storage copies in, e.g. the RK4 method
-template <typename A, typename B>
-Pair<A, B> couple(A a, B b) {
-    return { std::move(a), std::move(b) };
+template <typename... Ts>
+Coupled<Ts...> couple(Ts... xs) {
+    return { std::move(xs)... };
 }
 
-template <typename A, typename B, typename C>
-Triplet<A, B, C> couple(A a, B b, C c) {
-    return { std::move(a), std::move(b), std::move(c) };
+//////////////////////////////////////////////////////////////////////////////////////////
+// Reductions over coupled objects and expressions. These traverse the expression
+// lazily, in a single pass over memory, so that e.g. norm(x - y) does not need a
+// temporary object. Components that can be bound are reduced with the fast path,
+// and split across threads like the assignment. Optionally, the contribution of
+// each component is multiplied by a weight, e.g. to exclude a quadrature.
+
+// first leaf of an expression, used to find the number and types of components
+template <typename E>
+struct _first_leaf;
+
+template <typename... Ts>
+struct _first_leaf<Coupled<Ts...>> {
+    using type = Coupled<Ts...>;
+};
+
+template <typename ARG, typename S>
+struct _first_leaf<CoupledMul<ARG, S>> : _first_leaf<ARG> {};
+
+template <typename ARG, typename S>
+struct _first_leaf<CoupledDiv<ARG, S>> : _first_leaf<ARG> {};
+
+template <typename ARG1, typename ARG2>
+struct _first_leaf<CoupledAdd<ARG1, ARG2>> : _first_leaf<ARG1> {};
+
+template <typename ARG1, typename ARG2>
+struct _first_leaf<CoupledSub<ARG1, ARG2>> : _first_leaf<ARG1> {};
+
+template <typename E>
+using _first_leaf_t = typename _first_leaf<E>::type;
+
+// number of components of a coupled object or expression
+template <typename E>
+struct coupled_size : coupled_size<_first_leaf_t<E>> {};
+
+template <typename... Ts>
+struct coupled_size<Coupled<Ts...>> : std::integral_constant<std::size_t, sizeof...(Ts)> {};
+
+// helper definition
+template <typename E>
+inline constexpr static std::size_t coupled_size_v = coupled_size<E>::value;
+
+// number of elements of the n-th component of an expression, from its first leaf
+template <std::size_t n, typename... Ts>
+inline std::size_t _size(const Coupled<Ts...>& v) { return std::get<n>(v).size(); }
+
+template <std::size_t n, typename ARG, typename S>
+inline std::size_t _size(const CoupledMul<ARG, S>& v) { return _size<n>(v.arg); }
+
+template <std::size_t n, typename ARG, typename S>
+inline std::size_t _size(const CoupledDiv<ARG, S>& v) { return _size<n>(v.arg); }
+
+template <std::size_t n, typename ARG1, typename ARG2>
+inline std::size_t _size(const CoupledAdd<ARG1, ARG2>& v) { return _size<n>(v.arg1); }
+
+template <std::size_t n, typename ARG1, typename ARG2>
+inline std::size_t _size(const CoupledSub<ARG1, ARG2>& v) { return _size<n>(v.arg1); }
+
+// reduction operators
+struct _DotOp {
+    constexpr static double init = 0;
+
+    template <typename X, typename Y>
+    static inline double apply(double acc, const X& x, const Y& y) { return acc + x * y; }
+    static inline double combine(double a, double b) { return a + b; }
+};
+
+struct _SumSquaresOp {
+    constexpr static double init = 0;
+
+    template <typename X>
+    static inline double apply(double acc, const X& x) { return acc + x * x; }
+    static inline double combine(double a, double b) { return a + b; }
+};
+
+// maximum of a and b, which is NaN if either is, wherever it appears in
+// the sequence of reduced values
+inline double _nan_max(double a, double b) { return (b > a || b != b) ? b : a; }
+
+struct _MaxAbsOp {
+    constexpr static double init = 0;
+
+    template <typename X>
+    static inline double apply(double acc, const X& x) {
+        double ax = x < 0 ? -x : x;
+        return _nan_max(acc, ax);
+    }
+    static inline double combine(double a, double b) { return _nan_max(a, b); }
+};
+
+// Reduce bound expressions over [begin, end). Floating point additions are not
+// associative, so the compiler does not vectorize a loop with a single accumulator
+// unless we enable -ffast-math. We use instead several independent accumulators,
+// enough to fill the widest vector registers and hide the latency of the adds.
+template <typename OP, typename... BOUND>
+inline double _reduce_kernel(const OP op, std::size_t begin, std::size_t end, const BOUND... exprs) {
+    constexpr std::size_t LANES = 8;
+
+    double acc[LANES];
+    for (std::size_t l = 0; l != LANES; l++)
+        acc[l] = OP::init;
+
+    std::size_t i = begin;
+    for (; i + LANES <= end; i += LANES)
+        for (std::size_t l = 0; l != LANES; l++)
+            acc[l] = op.apply(acc[l], exprs[i + l]...);
+
+    // scalar tail
+    for (; i != end; i++)
+        acc[0] = op.apply(acc[0], exprs[i]...);
+
+    double result = OP::init;
+    for (std::size_t l = 0; l != LANES; l++)
+        result = op.combine(result, acc[l]);
+    return result;
+}
+
+// reduce the n-th component of one or more expressions
+template <std::size_t n, typename OP, typename E, typename... Es>
+inline double _reduce_component(const OP& op, const E& expr, const Es&... exprs) {
+    if constexpr (std::is_arithmetic_v<_component_t<n, _first_leaf_t<E>>>) {
+        return op.apply(OP::init, std::get<n>(expr), std::get<n>(exprs)...);
+    } else if constexpr (_is_bindable<n, E>::value && (_is_bindable<n, Es>::value && ...)) {
+        // fast path for contiguous storage
+        return _parallel_reduce(_size<n>(expr), 8, OP::init,
+            [&](std::size_t begin, std::size_t end) {
+                return _reduce_kernel(op, begin, end, _bind<n>(expr), _bind<n>(exprs)...);
+            },
+            OP::combine);
+    } else {
+        double acc = OP::init;
+        for (std::size_t i = 0, size = _size<n>(expr); i != size; i++)
+            acc = op.apply(acc, std::get<n>(expr, i), std::get<n>(exprs, i)...);
+        return acc;
+    }
+}
+
+// reduce all components and combine the weighted results
+template <typename OP, typename W, std::size_t... Is, typename... Es>
+inline double _reduce(const OP& op, const W& weights, std::index_sequence<Is...>, const Es&... exprs) {
+    double result = OP::init;
+    ((result = OP::combine(result, weights[Is] * _reduce_component<Is>(op, exprs...))), ...);
+    return result;
+}
+
+// used when no weights are given
+struct _UnitWeights {
+    constexpr double operator[](std::size_t) const { return 1.0; }
+};
+
+// weights of the components of an expression
+template <typename E>
+using weights_t = std::array<double, coupled_size_v<E>>;
+
+// inner product
+template <typename E1, typename E2>
+inline double dot(const CoupledExpr<E1>& x, const CoupledExpr<E2>& y) {
+    static_assert(coupled_size_v<E1> == coupled_size_v<E2>, "incompatible arguments");
+    return _reduce(_DotOp(), _UnitWeights(), std::make_index_sequence<coupled_size_v<E1>>(),
+        static_cast<const E1&>(x), static_cast<const E2&>(y));
+}
+
+template <typename E1, typename E2>
+inline double dot(const CoupledExpr<E1>& x, const CoupledExpr<E2>& y, const weights_t<E1>& weights) {
+    static_assert(coupled_size_v<E1> == coupled_size_v<E2>, "incompatible arguments");
+    return _reduce(_DotOp(), weights, std::make_index_sequence<coupled_size_v<E1>>(),
+        static_cast<const E1&>(x), static_cast<const E2&>(y));
+}
+
+// Euclidean norm. With weights w_k, this is the square root of the
+// sum over the components of w_k times their squared norm.
+template <typename E>
+inline double norm(const CoupledExpr<E>& x) {
+    return std::sqrt(_reduce(_SumSquaresOp(), _UnitWeights(),
+        std::make_index_sequence<coupled_size_v<E>>(), static_cast<const E&>(x)));
+}
+
+template <typename E>
+inline double norm(const CoupledExpr<E>& x, const weights_t<E>& weights) {
+    return std::sqrt(_reduce(_SumSquaresOp(), weights,
+        std::make_index_sequence<coupled_size_v<E>>(), static_cast<const E&>(x)));
+}
+
+// maximum absolute value. With weights, this is the maximum over the
+// components of w_k times their maximum absolute value.
+template <typename E>
+inline double max_abs(const CoupledExpr<E>& x) {
+    return _reduce(_MaxAbsOp(), _UnitWeights(),
+        std::make_index_sequence<coupled_size_v<E>>(), static_cast<const E&>(x));
+}
+
+template <typename E>
+inline double max_abs(const CoupledExpr<E>& x, const weights_t<E>& weights) {
+    return _reduce(_MaxAbsOp(), weights,
+        std::make_index_sequence<coupled_size_v<E>>(), static_cast<const E&>(x));
+}
+
+// Scaled norm of the local error e of a time step from x to y, i.e. the
+// maximum of |e_i| / (atol + rtol * max(|x_i|, |y_i|)) over all elements.
+// A step is acceptable when this is not larger than one, and a NaN in any
+// element gives a NaN, so that the step is rejected. Arithmetic types
+// and indexable containers, e.g. std::valarray, are also accepted.
+struct _ErrorOp {
+    constexpr static double init = 0;
+    double atol;
+    double rtol;
+
+    template <typename E, typename X, typename Y>
+    inline double apply(double acc, const E& e, const X& x, const Y& y) const {
+        double ae = e < 0 ? -e : e;
+        double ax = x < 0 ? -x : x;
+        double ay = y < 0 ? -y : y;
+        double r  = ae / (atol + rtol * (ax > ay ? ax : ay));
+        return _nan_max(acc, r);
+    }
+    static inline double combine(double a, double b) { return _nan_max(a, b); }
+};
+
+template <typename E, typename X, typename Y>
+inline double error_norm(const E& e, const X& x, const Y& y, double atol, double rtol) {
+    _ErrorOp op{ atol, rtol };
+    if constexpr (std::is_base_of_v<CoupledExpr<E>, E>) {
+        return _reduce(op, _UnitWeights(), std::make_index_sequence<coupled_size_v<E>>(), e, x, y);
+    } else if constexpr (std::is_arithmetic_v<E>) {
+        return op.apply(_ErrorOp::init, e, x, y);
+    } else {
+        double acc = _ErrorOp::init;
+        for (std::size_t i = 0, size = x.size(); i != size; i++)
+            acc = op.apply(acc, e[i], x[i], y[i]);
+        return acc;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Assignment of several expressions to several targets in a single loop, i.e.
+//
+//      assign_all(x, expr1, y, expr2, ...)
+//
+// The semantics is that of a simultaneous assignment: all expressions are evaluated
+// with the values the targets had before the call, as if they were first evaluated
+// into temporaries. For instance, assign_all(x, y, y, x) swaps x and y. Since the
+// expressions are element-wise, this is achieved without temporaries by evaluating
+// all expressions at index i before writing to the targets at index i. This saves
+// memory passes over data shared by the expressions, e.g. in the update of the
+// state and of the next stage of a low-storage Runge-Kutta method. The targets can
+// be coupled objects, arithmetic types, or containers with size() and operator[],
+// e.g. std::valarray, for which the expressions must be indexable too.
+
+// checks whether T is a Coupled object
+template <typename T>
+struct _is_coupled : std::false_type {};
+
+template <typename... Ts>
+struct _is_coupled<Coupled<Ts...>> : std::true_type {};
+
+template <typename T>
+inline constexpr static bool _is_coupled_v = _is_coupled<std::decay_t<T>>::value;
+
+// evaluate bound expressions into several outputs over [begin, end)
+template <typename DSTS, typename BOUNDS, std::size_t... Ks>
+inline void _kernel_all(const DSTS dsts, const BOUNDS exprs,
+    std::size_t begin, std::size_t end, std::index_sequence<Ks...>) {
+    _FLOWS_IVDEP
+    for (std::size_t i = begin; i < end; i++) {
+        auto vals = std::make_tuple(std::get<Ks>(exprs)[i]...);
+        ((std::get<Ks>(dsts)[i] = std::get<Ks>(vals)), ...);
+    }
+}
+
+// assign the n-th component of all targets
+template <std::size_t n, typename ARGS, std::size_t... Ks>
+inline void _assign_all_component(ARGS& args, std::index_sequence<Ks...> ks) {
+    using X0 = std::remove_reference_t<decltype(std::get<n>(std::get<0>(args)))>;
+    using E  = std::tuple<std::decay_t<std::tuple_element_t<2 * Ks + 1, ARGS>>...>;
+
+    if constexpr (std::is_arithmetic_v<X0>) {
+        auto vals = std::make_tuple(std::get<n>(std::get<2 * Ks + 1>(args))...);
+        ((std::get<n>(std::get<2 * Ks>(args)) = std::get<Ks>(vals)), ...);
+    } else if constexpr ((_is_contiguous_v<decltype(std::get<n>(std::get<2 * Ks>(args)))> && ...)
+        && (_is_bindable<n, std::tuple_element_t<Ks, E>>::value && ...)) {
+        // fast path for contiguous storage
+        auto dsts  = std::make_tuple(_data(std::get<n>(std::get<2 * Ks>(args)))...);
+        auto exprs = std::make_tuple(_bind<n>(std::get<2 * Ks + 1>(args))...);
+        using T    = _elem_t<X0>;
+        constexpr std::size_t ALIGN = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+        _parallel_for(std::get<n>(std::get<0>(args)).size(), ALIGN,
+            [&](std::size_t begin, std::size_t end) {
+                _kernel_all(dsts, exprs, begin, end, ks);
+            });
+    } else {
+        for (std::size_t i = 0, size = std::get<n>(std::get<0>(args)).size(); i != size; i++) {
+            auto vals = std::make_tuple(std::get<n>(std::get<2 * Ks + 1>(args), i)...);
+            ((std::get<n>(std::get<2 * Ks>(args), i) = std::get<Ks>(vals)), ...);
+        }
+    }
+}
+
+template <typename ARGS, std::size_t... Ks, std::size_t... Ns>
+inline void _assign_all_coupled(ARGS& args, std::index_sequence<Ks...> ks, std::index_sequence<Ns...>) {
+    (_assign_all_component<Ns>(args, ks), ...);
+}
+
+template <typename ARGS, std::size_t... Ks>
+inline void _assign_all(ARGS& args, std::index_sequence<Ks...> ks) {
+    using X0 = std::decay_t<std::tuple_element_t<0, ARGS>>;
+
+    if constexpr ((_is_coupled_v<std::tuple_element_t<2 * Ks, ARGS>> && ...)) {
+        static_assert(((coupled_size_v<std::decay_t<std::tuple_element_t<2 * Ks, ARGS>>>
+                           == coupled_size_v<X0>)&&...),
+            "targets must have the same number of components");
+        _assign_all_coupled(args, ks, std::make_index_sequence<coupled_size_v<X0>>());
+    } else if constexpr (std::is_arithmetic_v<X0>) {
+        // expressions have already been evaluated at the call site
+        auto vals = std::make_tuple(std::decay_t<std::tuple_element_t<2 * Ks, ARGS>>(std::get<2 * Ks + 1>(args))...);
+        ((std::get<2 * Ks>(args) = std::get<Ks>(vals)), ...);
+    } else {
+        for (std::size_t i = 0, size = std::get<0>(args).size(); i != size; i++) {
+            auto vals = std::make_tuple(std::get<2 * Ks + 1>(args)[i]...);
+            ((std::get<2 * Ks>(args)[i] = std::get<Ks>(vals)), ...);
+        }
+    }
+}
+
+template <typename... ARGS>
+inline void assign_all(ARGS&&... args) {
+    static_assert(sizeof...(ARGS) % 2 == 0, "arguments must be (target, expression) pairs");
+    auto args_tuple = std::forward_as_tuple(args...);
+    _assign_all(args_tuple, std::make_index_sequence<sizeof...(ARGS) / 2>());
+}
+
+// Same as assign_all, restricted to the pairs whose flag is true, e.g.
+// assign_all_if<true, false>(x, expr1, y, expr2) is just x = expr1. This
+// is used when the pairs to be assigned are known at compile time only.
+template <bool FLAG, typename T, typename E>
+inline auto _select_pair(T& target, const E& expr) {
+    if constexpr (FLAG) {
+        return std::forward_as_tuple(target, expr);
+    } else {
+        return std::tuple<>();
+    }
+}
+
+template <bool... FLAGS, typename ARGS, std::size_t... Ks>
+inline void _assign_all_if(ARGS& args, std::index_sequence<Ks...>) {
+    auto selected = std::tuple_cat(_select_pair<FLAGS>(std::get<2 * Ks>(args), std::get<2 * Ks + 1>(args))...);
+    if constexpr (std::tuple_size_v<decltype(selected)> > 0)
+        std::apply([](auto&... xs) { assign_all(xs...); }, selected);
+}
+
+template <bool... FLAGS, typename... ARGS>
+inline void assign_all_if(ARGS&&... args) {
+    static_assert(sizeof...(ARGS) == 2 * sizeof...(FLAGS), "one flag per (target, expression) pair");
+    auto args_tuple = std::forward_as_tuple(args...);
+    _assign_all_if<FLAGS...>(args_tuple, std::make_index_sequence<sizeof...(FLAGS)>());
+}
+
+// one of two objects, selected at compile time
+template <bool FIRST, typename A, typename B>
+inline const auto& _pick(const A& a, const B& b) {
+    if constexpr (FIRST) {
+        return a;
+    } else {
+        return b;
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// Utility to remove the references from the template parameters of a Pair or Triplet.
+// Utility to remove the references from the template parameters of a Coupled object.
 // This is used to define the argument type of the method 'push_back' of monitors and
 // stage caches, to check
 template <typename T>
@@ -330,14 +888,9 @@ struct remove_refs_from_coupled {
     using type = T;
 };
 
-template <typename A, typename B>
-struct remove_refs_from_coupled<Pair<A&, B&>> {
-    using type = Pair<A, B>;
-};
-
-template <typename A, typename B, typename C>
-struct remove_refs_from_coupled<Triplet<A&, B&, C&>> {
-    using type = Triplet<A, B, C>;
+template <typename... Ts>
+struct remove_refs_from_coupled<Coupled<Ts...>> {
+    using type = Coupled<std::remove_reference_t<Ts>...>;
 };
 
 // helper definition
@@ -348,7 +901,7 @@ using remove_refs_from_coupled_t = typename remove_refs_from_coupled<T>::type;
 // is_ref_compatible<Pair<A, B>, Pair<A&, B&>> == true
 // is_ref_compatible<Pair<A, B>, Pair<A, B>> == true
 // is_ref_compatible<Pair<A, B>, Pair<C, B>> == false
-// is_ref_compatible<Triplet<A, B, C>, Triplet<A&, B&, C&>> == false
+// is_ref_compatible<Triplet<A, B, C>, Pair<A&, B&>> == false
 template <typename A, typename B>
 struct is_ref_compatible {
     constexpr static bool value = std::is_same_v<A, remove_refs_from_coupled_t<B>> || std::is_same_v<B, remove_refs_from_coupled_t<A>>;
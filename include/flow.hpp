@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
 #include <type_traits>
 
 #include "coupled.hpp"
@@ -7,6 +12,7 @@
 #include "stagecache.hpp"
 #include "stepping.hpp"
 #include "timerange.hpp"
+#include "steps/generic.hpp"
 
 namespace Flows {
 
@@ -33,6 +39,9 @@ X& _propagate(TimeStepConstant& stepping,
     if (t_from == t_to)
         throw std::invalid_argument("time span endpoints must differ");
 
+    // restart methods with a history, e.g. multistep methods
+    _restart(method, 0);
+
     // march in time
     for (auto [t, dt_loc] : TimeRange(t_from, t_to, stepping.dt)) {
 
@@ -49,16 +58,77 @@ X& _propagate(TimeStepConstant& stepping,
     return x;
 }
 
+////////////////////////////////////////////////////////////////
+// map state from t_from to t_to using adaptive time stepping. Only
+// the accepted steps are pushed to the monitor and to the stage cache
+template <
+    typename X,
+    typename SYSTEM,
+    typename METHOD,
+    typename MONITOR,
+    typename STAGECACHE>
+X& _propagate(TimeStepAdaptive& stepping,
+    SYSTEM&                     system,
+    METHOD&                     method,
+    X&                          x,
+    double                      t_from,
+    double                      t_to,
+    MONITOR&&                   m,
+    STAGECACHE&&                cache) {
+
+    if (t_from == t_to)
+        throw std::invalid_argument("time span endpoints must differ");
+
+    constexpr std::size_t k = std::decay_t<METHOD>::error_exponent;
+
+    stepping.restart();
+    method.restart();
+    _record_stages(method, 0, _stores_stages_v<STAGECACHE>);
+
+    double t  = t_from;
+    double dt = std::copysign(std::min(stepping.dt_init, stepping.dt_max), t_to - t_from);
+
+    while (t != t_to) {
+
+        // push state to monitor
+        m.push_back(t, x);
+
+        // do not step past the end
+        bool last = std::fabs(dt) >= std::fabs(t_to - t);
+        if (last)
+            dt = t_to - t;
+
+        // attempt steps until one is accepted. Note that a NaN error is rejected,
+        // and that reject throws for it, and here throw if t does not advance
+        double err = try_step(method, system, t, dt, x, stepping.atol, stepping.rtol);
+        while (!(err <= 1)) {
+            dt = stepping.reject(dt, err, k);
+            if (t + dt == t)
+                throw std::runtime_error("time step below round-off");
+            last = false;
+            err  = try_step(method, system, t, dt, x, stepping.atol, stepping.rtol);
+        }
+        accept_step(method, system, t, dt, x, std::forward<STAGECACHE>(cache));
+
+        // advance
+        t  = last ? t_to : t + dt;
+        dt = stepping.accept(dt, err, k);
+    }
+
+    // push final state to monitor before exiting
+    m.push_back(t_to, x);
+
+    return x;
+}
+
 ////////////////////////////////////////////////////////////////
 // map state from t_from to t_to using a stage cache
 template <
     typename X,
     typename SYSTEM,
-    typename METHOD, // number of storage vectors
-    typename Y, // data type (stripped of references for Pairs and Triplets)
-    typename STAGECACHE> // number of stages
-X&
-_propagate(TimeStepFromStageCache& stepping,
+    typename METHOD,
+    typename STAGECACHE>
+X& _propagate(TimeStepFromStageCache& stepping,
     SYSTEM&                        system,
     METHOD&                        method,
     X&                             x,
@@ -67,12 +137,71 @@ _propagate(TimeStepFromStageCache& stepping,
     static_assert(isAdjoint<METHOD>::value, 
         "can't integrate non adjoint system using stage cache");
 
+    // restart methods with a history, with the number of cache entries
+    _restart(method, 0, std::size_t(std::distance(cache.begin(), cache.end())));
+
     for (auto [t, dt, stages] : reverse(cache))
         step(method, system, t, dt, x, stages);
 
     return x;
 }
 
+////////////////////////////////////////////////////////////////
+// LOCAL RECOMPUTATION OF THE STAGES
+
+// Make the forward step from x at t again, pushing its stages. Methods
+// without a fixed step, e.g. EmbeddedRK, attempt the step and accept it,
+// after a restart, as the first stage of an FSAL method is not kept, with
+// the stages of the attempt recorded, so that they are not formed again.
+template <typename METHOD, typename SYSTEM, typename X, typename STAGES>
+inline auto _recompute_step(METHOD& method, SYSTEM& sys, double t, double dt, X& x, STAGES& stages, int)
+    -> decltype(step(method, sys, t, dt, x, stages)) {
+    step(method, sys, t, dt, x, stages);
+}
+
+template <typename METHOD, typename SYSTEM, typename X, typename STAGES>
+inline void _recompute_step(METHOD& method, SYSTEM& sys, double t, double dt, X& x, STAGES& stages, long) {
+    bool record = _record_stages(method, 0, true);
+    _restart(method, 0);
+    try_step(method, sys, t, dt, x, 1.0, 1.0);
+    accept_step(method, sys, t, dt, x, stages);
+    _record_stages(method, 0, record);
+}
+
+// Stage cache passed to the forward steps with local recomputation. The
+// state at the beginning of each step is pushed to the cache, and the
+// stages are discarded.
+template <typename Y, std::size_t N, typename X>
+class _StateRecorder {
+private:
+    AbstractStageCache<Y, N>& _cache;
+    const X&                  _x;
+    Y                         _y;
+
+public:
+    _StateRecorder(AbstractStageCache<Y, N>& cache, const X& x, const Y& y)
+        : _cache(cache)
+        , _x(x)
+        , _y(y) {}
+
+    void setup_step(double t, double dt) {
+        _cache.setup_step(t, dt);
+        if (Y* slot = _cache.next_slot()) {
+            *slot = _x;
+        } else {
+            _y = _x;
+            _cache.push_back(_y);
+        }
+    }
+
+    void push_back(const Y& y) {}
+
+    void close_step() { _cache.close_step(); }
+};
+
+template <typename Y, std::size_t N, typename X>
+struct _stores_stages<_StateRecorder<Y, N, X>> : std::false_type {};
+
 ////////////////////////////////////////////////////////////////
 // THE FLOW OBJECT
 template <
@@ -84,6 +213,7 @@ private:
     SYSTEM&   _system;
     METHOD&   _method;
     STEPPING& _stepping;
+    bool      _local_recomputation = false;
 
 public:
     // constructor
@@ -131,11 +261,43 @@ public:
             NoOpStageCache<Y>());
     }
 
+    // With local recomputation, the stage caches filled by the flow only
+    // store the state at the beginning of each step, and the stages of a
+    // step are formed again from it, by the method and system of the flow,
+    // when they are read, e.g. by the adjoint integration over the cache.
+    // This takes one more forward step for each adjoint step, but only one
+    // state per step is stored instead of the N stages. The cache must
+    // support it, e.g. RAMStageCache, and the method and system must
+    // outlive it. Methods with a history, e.g. multistep methods, are not
+    // supported, as each step is formed again on its own, and are rejected.
+    void set_local_recomputation(bool on) {
+        if (on && _has_history_v<METHOD>)
+            throw std::invalid_argument("local recomputation needs a method without history");
+        _local_recomputation = on;
+    }
+
+    bool local_recomputation() const { return _local_recomputation; }
+
     // fill the stage cache from t_from to t_to
     template <typename X, typename T1, typename T2, typename Y, std::size_t N>
     X& operator()(X& x, T1 t_from, T2 t_to, AbstractStageCache<Y, N>& c) {
         static_assert(is_ref_compatible_v<X, Y>,
             "incompatible cache and input types");
+        if (_local_recomputation) {
+            c.recompute_with([&method = _method, &system = _system](
+                                 double t, double dt, Y& y, _StepStages<Y>& stages) {
+                _recompute_step(method, system, t, dt, y, stages, 0);
+            });
+            return _propagate(_stepping,
+                _system,
+                _method,
+                x,
+                double(t_from),
+                double(t_to),
+                NoOpMonitor<X>(),
+                _StateRecorder<Y, N, X>(c, x, _method.storage[0]));
+        }
+        c.recompute_with({});
         return _propagate(_stepping,
             _system,
             _method,
@@ -148,8 +310,10 @@ public:
 
     // integrate based on a stage cache only, i.e. not filling the cache
     // but using the stages stored for the forward/backward integration.
-    template <typename X, typename Y, std::size_t N>
-    X& operator()(X& x, AbstractStageCache<Y, N>& c) {
+    // The cache is taken with its actual type, for the iteration, and
+    // may have further template parameters, e.g. a codec.
+    template <typename X, template <typename, std::size_t, typename...> typename CACHE, typename Y, std::size_t N, typename... ARGS>
+    X& operator()(X& x, CACHE<Y, N, ARGS...>& c) {
         static_assert(is_ref_compatible_v<X, Y>,
             "incompatible cache and input types");
         return _propagate(_stepping,
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Policy for the reuse of the Jacobian approximation of linearly implicit
+// methods, e.g. Rosenbrock-W methods, which keep their order with a stale
+// Jacobian. The Jacobian is built at the first step of an integration and
+// rebuilt once it has been used for max_age steps, or when the state has
+// changed since the last build by more than the tolerances, i.e. when the
+// error_norm of the change exceeds one. This check is disabled with the
+// default rtol. The default max_age rebuilds the Jacobian at every step.
+// The numbers of builds and of linear solves in the last integration are
+// recorded, to tune the reuse against the number of steps.
+struct JacobianReuse {
+    std::size_t max_age = 1;
+    double      rtol    = std::numeric_limits<double>::infinity();
+    double      atol    = 0;
+
+    // statistics of the last integration
+    std::size_t njacobians = 0;
+    std::size_t nsolves    = 0;
+
+    // whether there is a Jacobian, and the number of steps it was used for
+    bool        _has_jacobian = false;
+    std::size_t _age          = 0;
+
+    // call at the beginning of an integration
+    void restart() {
+        _has_jacobian = false;
+        njacobians    = 0;
+        nsolves       = 0;
+    }
+
+    // whether the change of the state is checked
+    bool _check_state() const {
+        return rtol != std::numeric_limits<double>::infinity();
+    }
+};
+}
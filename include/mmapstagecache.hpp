@@ -0,0 +1,413 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "coupled.hpp"
+#include "stagecache.hpp"
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// SERIALISATION OF STAGES INTO A MAPPING. Each type stored in an
+// MmapStageCache has a specialisation of MmapTraits, with
+//
+//      size(x)     number of bytes needed to store x
+//      size(p)     number of bytes of the object stored at p
+//      write(p, x) store x at p
+//      read(p, x)  set x from the object stored at p
+//      make(p)     construct a new object from the object stored at p
+//
+// Objects are stored at addresses aligned to _mmap_alignment bytes. If
+// zero_copy is true, view(p) returns a reference to the object stored
+// at p, and the stages are read in place.
+inline constexpr std::size_t _mmap_alignment = 16;
+
+inline constexpr std::size_t _mmap_align(std::size_t n) {
+    return (n + _mmap_alignment - 1) / _mmap_alignment * _mmap_alignment;
+}
+
+template <typename T, typename = void>
+struct MmapTraits;
+
+// trivially copyable types are stored as they are in memory
+template <typename T>
+struct MmapTraits<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static_assert(alignof(T) <= _mmap_alignment, "invalid alignment");
+
+    static constexpr bool zero_copy = true;
+
+    static std::size_t size(const T&) { return sizeof(T); }
+    static std::size_t size(const char*) { return sizeof(T); }
+    static void        write(char* p, const T& x) { std::memcpy(p, &x, sizeof(T)); }
+    static void        read(const char* p, T& x) { std::memcpy(&x, p, sizeof(T)); }
+    static T           make(const char* p) { return view(p); }
+    static const T&    view(const char* p) { return *reinterpret_cast<const T*>(p); }
+};
+
+// contiguous containers of arithmetic types, stored as the number of
+// elements followed by the elements
+template <typename C, typename T>
+struct _MmapContiguousTraits {
+    static_assert(std::is_arithmetic_v<T>, "invalid element type");
+
+    static constexpr bool zero_copy = false;
+
+    static std::size_t size(const C& x) { return _mmap_alignment + x.size() * sizeof(T); }
+
+    static std::size_t size(const char* p) {
+        std::uint64_t n;
+        std::memcpy(&n, p, sizeof(n));
+        return _mmap_alignment + n * sizeof(T);
+    }
+
+    static void write(char* p, const C& x) {
+        std::uint64_t n = x.size();
+        std::memcpy(p, &n, sizeof(n));
+        if (n > 0)
+            std::memcpy(p + _mmap_alignment, &x[0], n * sizeof(T));
+    }
+
+    static void read(const char* p, C& x) {
+        std::uint64_t n;
+        std::memcpy(&n, p, sizeof(n));
+        if (x.size() != n)
+            x.resize(n);
+        if (n > 0)
+            std::memcpy(&x[0], p + _mmap_alignment, n * sizeof(T));
+    }
+
+    static C make(const char* p) {
+        C x;
+        read(p, x);
+        return x;
+    }
+};
+
+template <typename T>
+struct MmapTraits<std::valarray<T>> : _MmapContiguousTraits<std::valarray<T>, T> {};
+
+template <typename T>
+struct MmapTraits<std::vector<T>> : _MmapContiguousTraits<std::vector<T>, T> {};
+
+// coupled objects, one aligned component after the other
+template <typename... Ts>
+struct MmapTraits<Coupled<Ts...>> {
+    static constexpr bool zero_copy = false;
+
+    static std::size_t size(const Coupled<Ts...>& x) {
+        return std::apply([](const Ts&... xs) {
+            return (std::size_t(0) + ... + _mmap_align(MmapTraits<Ts>::size(xs)));
+        }, x._elems);
+    }
+
+    static std::size_t size(const char* p) {
+        return _offsets(p).back();
+    }
+
+    static void write(char* p, const Coupled<Ts...>& x) {
+        std::apply([&](const Ts&... xs) {
+            ((MmapTraits<Ts>::write(p, xs), p += _mmap_align(MmapTraits<Ts>::size(xs))), ...);
+        }, x._elems);
+    }
+
+    static void read(const char* p, Coupled<Ts...>& x) {
+        std::apply([&](Ts&... xs) {
+            ((MmapTraits<Ts>::read(p, xs), p += _mmap_align(MmapTraits<Ts>::size(p))), ...);
+        }, x._elems);
+    }
+
+    static Coupled<Ts...> make(const char* p) {
+        return _make(p, _offsets(p), std::index_sequence_for<Ts...>());
+    }
+
+private:
+    // offsets of the components, and the total size at the end
+    static std::array<std::size_t, sizeof...(Ts) + 1> _offsets(const char* p) {
+        std::array<std::size_t, sizeof...(Ts) + 1> offsets = { 0 };
+        std::size_t                                 k       = 0;
+        ((offsets[k + 1] = offsets[k] + _mmap_align(MmapTraits<Ts>::size(p + offsets[k])), k++), ...);
+        return offsets;
+    }
+
+    template <typename OFFSETS, std::size_t... Is>
+    static Coupled<Ts...> _make(const char* p, const OFFSETS& offsets, std::index_sequence<Is...>) {
+        return Coupled<Ts...>(MmapTraits<Ts>::make(p + offsets[Is])...);
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Indexable sequence of the stages in a mapping, used by the views of
+// MmapStageCache. Stages are returned in place if their type allows it,
+// or decoded into one register for each of the N stages of a step, as
+// adjoint steps use one stage at a time. The pages before the stage
+// being read are advised to be needed, as stages are read backwards.
+template <typename X, std::size_t N>
+class _MmapStages {
+private:
+    const char*                                 _data = nullptr;
+    std::size_t                                 _size = 0;
+    std::vector<std::size_t>                    _offsets;
+    mutable std::array<std::unique_ptr<X>, N>   _registers;
+    mutable std::size_t                         _advised_lo = 0;
+    mutable std::size_t                         _advised_hi = 0;
+
+    // bytes advised to be needed ahead of the stage being read
+    static constexpr std::size_t _readahead = std::size_t(1) << 23;
+
+    void _advise(std::size_t lo, std::size_t hi) const {
+        const std::size_t page = std::size_t(sysconf(_SC_PAGESIZE));
+        lo                     = lo / page * page;
+        if (lo < hi)
+            madvise(const_cast<char*>(_data) + lo, hi - lo, MADV_WILLNEED);
+        _advised_lo = lo;
+        _advised_hi = hi;
+    }
+
+public:
+    // set the mapping, after it was created or moved
+    void map(const char* data, std::size_t size) {
+        _data       = data;
+        _size       = size;
+        _advised_lo = 0;
+        _advised_hi = 0;
+    }
+
+    void push_back(std::size_t offset) { _offsets.push_back(offset); }
+
+    // disable the default read ahead, which assumes forward access
+    void advise_random() const {
+        if (_size > 0)
+            madvise(const_cast<char*>(_data), _size, MADV_RANDOM);
+    }
+
+    const X& operator[](std::size_t i) const {
+        const char* p   = _data + _offsets[i];
+        std::size_t end = _offsets[i] + MmapTraits<X>::size(p);
+        if (_offsets[i] < _advised_lo || end > _advised_hi)
+            _advise(end > _readahead ? end - _readahead : 0, end);
+
+        if constexpr (MmapTraits<X>::zero_copy) {
+            return MmapTraits<X>::view(p);
+        } else {
+            auto& reg = _registers[i % N];
+            if (reg) {
+                MmapTraits<X>::read(p, *reg);
+            } else {
+                reg = std::make_unique<X>(MmapTraits<X>::make(p));
+            }
+            return *reg;
+        }
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// MEMORY MAPPED STAGE CACHE, e.g.
+//
+//      auto cache = MmapStageCache<X, N>("forward.stages");
+//      phi(x, t_from, t_to, cache);
+//      phi_adj(w, cache);
+//
+// storing the stages in a file mapped in memory, which grows as needed,
+// so that the forward integration can exceed the memory and pages are
+// written back by the system. The stages are serialised with MmapTraits.
+// The file holds the times and the stages of the closed steps, and can be
+// opened by other processes with
+//
+//      auto cache = MmapStageCache<X, N>("forward.stages", MmapMode::ReadOnly);
+//
+// once the forward integration is done, e.g. to run several adjoint
+// integrations over the same forward solution. The file is kept on
+// destruction.
+enum class MmapMode { Create,
+                      ReadOnly };
+
+template <typename X, std::size_t N>
+class MmapStageCache : public AbstractStageCache<X, N> {
+private:
+    // file header, with the number of stages per step and of closed steps
+    struct _Header {
+        char          magic[8];
+        std::uint64_t nstages;
+        std::uint64_t nsteps;
+        std::uint64_t unused;
+    };
+
+    static constexpr char _magic[8] = "FLOWSMM";
+
+    int                 _fd;
+    bool                _readonly;
+    char*               _data;
+    std::size_t         _capacity;
+    std::size_t         _size;
+    std::vector<double> _ts;
+    std::vector<double> _dts;
+    _MmapStages<X, N>   _xs;
+
+    [[noreturn]] void _fail(const std::string& what) {
+        throw std::runtime_error("MmapStageCache: " + what + ": " + std::strerror(errno));
+    }
+
+    void _map(std::size_t capacity) {
+        if (_data != nullptr)
+            munmap(_data, _capacity);
+        const int prot = _readonly ? PROT_READ : PROT_READ | PROT_WRITE;
+        void*     data = mmap(nullptr, capacity, prot, MAP_SHARED, _fd, 0);
+        if (data == MAP_FAILED) {
+            _data = nullptr;
+            _fail("mmap");
+        }
+        _data     = static_cast<char*>(data);
+        _capacity = capacity;
+        _xs.map(_data, _size);
+    }
+
+    // make room for n more bytes, doubling the file size if needed
+    void _reserve(std::size_t n) {
+        if (_readonly)
+            throw std::logic_error("MmapStageCache: read only cache");
+        if (_size + n <= _capacity)
+            return;
+        std::size_t capacity = std::max(2 * _capacity, _size + n);
+        if (ftruncate(_fd, off_t(capacity)) != 0)
+            _fail("ftruncate");
+        _map(capacity);
+    }
+
+    _Header& _header() { return *reinterpret_cast<_Header*>(_data); }
+
+    // rebuild the times and the offsets of the stages of an existing file
+    void _scan() {
+        if (_capacity < sizeof(_Header) || std::memcmp(_header().magic, _magic, 8) != 0)
+            throw std::runtime_error("MmapStageCache: invalid file");
+        if (_header().nstages != N)
+            throw std::runtime_error("MmapStageCache: invalid number of stages");
+
+        std::size_t offset = _mmap_align(sizeof(_Header));
+        for (std::size_t i = 0; i != _header().nsteps; i++) {
+            double t_dt[2];
+            std::memcpy(t_dt, _data + offset, sizeof(t_dt));
+            _ts.push_back(t_dt[0]);
+            _dts.push_back(t_dt[1]);
+            offset += _mmap_align(sizeof(t_dt));
+            for (std::size_t k = 0; k != N; k++) {
+                _xs.push_back(offset);
+                offset += _mmap_align(MmapTraits<X>::size(_data + offset));
+            }
+        }
+        _size = offset;
+        _xs.map(_data, _size);
+    }
+
+public:
+    // create the file, with the given initial size in bytes, or open it
+    MmapStageCache(const std::filesystem::path& filename,
+                   MmapMode                     mode     = MmapMode::Create,
+                   std::size_t                  capacity = std::size_t(1) << 20)
+        : _fd(-1)
+        , _readonly(mode == MmapMode::ReadOnly)
+        , _data(nullptr)
+        , _capacity(0)
+        , _size(0) {
+        if (_readonly) {
+            _fd = open(filename.c_str(), O_RDONLY);
+            if (_fd < 0)
+                _fail("open " + filename.string());
+            struct stat st;
+            if (fstat(_fd, &st) != 0)
+                _fail("fstat");
+            _map(std::size_t(st.st_size));
+            _scan();
+        } else {
+            _fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (_fd < 0)
+                _fail("open " + filename.string());
+            capacity = std::max(capacity, _mmap_align(sizeof(_Header)));
+            if (ftruncate(_fd, off_t(capacity)) != 0)
+                _fail("ftruncate");
+            _map(capacity);
+            std::memcpy(_header().magic, _magic, 8);
+            _header().nstages = N;
+            _header().nsteps  = 0;
+            _header().unused  = 0;
+            _size             = _mmap_align(sizeof(_Header));
+        }
+    }
+
+    // unmap and trim the file to the stored data
+    ~MmapStageCache() {
+        if (_data != nullptr)
+            munmap(_data, _capacity);
+        if (_fd >= 0) {
+            // the file is still valid, only longer, if this fails
+            if (!_readonly)
+                (void)!ftruncate(_fd, off_t(_size));
+            close(_fd);
+        }
+    }
+
+    MmapStageCache(const MmapStageCache&) = delete;
+    MmapStageCache& operator=(const MmapStageCache&) = delete;
+
+    // this prepares storage space for a new step
+    void setup_step(double t, double dt) override {
+        const double t_dt[2] = { t, dt };
+        _reserve(_mmap_align(sizeof(t_dt)));
+        std::memcpy(_data + _size, t_dt, sizeof(t_dt));
+        _size += _mmap_align(sizeof(t_dt));
+        _ts.push_back(t);
+        _dts.push_back(dt);
+    }
+
+    // serialise a stage vector into the mapping
+    void push_back(const X& x) override {
+        const std::size_t n = _mmap_align(MmapTraits<X>::size(x));
+        _reserve(n);
+        MmapTraits<X>::write(_data + _size, x);
+        _xs.push_back(_size);
+        _size += n;
+    }
+
+    // the step is visible to readers of the file once closed
+    void close_step() override {
+        _header().nsteps = _ts.size();
+        _xs.map(_data, _size);
+    }
+
+    // number of bytes used in the file
+    std::size_t bytes() const { return _size; }
+
+    // indexing (mainly for testing code)
+    auto operator[](std::size_t i) {
+        return std::make_tuple(_ts[i], _dts[i], View<_MmapStages<X, N>, N>(_xs, i * N));
+    }
+
+    // iteration support
+    auto begin() const {
+        _xs.advise_random();
+        return StageIterator<std::vector<double>, _MmapStages<X, N>, N>(_ts, _dts, _xs, 0);
+    }
+    auto end() const {
+        _xs.advise_random();
+        return StageIterator<std::vector<double>, _MmapStages<X, N>, N>(_ts, _dts, _xs, _ts.size());
+    }
+};
+}
@@ -31,19 +31,14 @@ struct Identity {
     }
 };
 
-// when we pass a Pair or Triplet that contains
+// when we pass a Coupled object that contains
 // references, we make a copy of the data and return it.
 // There should not be any further copies down the line
 // because
 struct Copy {
-    template <typename A, typename B>
-    Pair<A, B> operator()(const Pair<A&, B&>& x) {
-        return couple(std::get<0>(x), std::get<1>(x));
-    }
-
-    template <typename A, typename B, typename C>
-    Triplet<A, B, C> operator()(const Triplet<A&, B&, C&>& x) {
-        return couple(std::get<0>(x), std::get<1>(x), std::get<2>(x));
+    template <typename... Ts>
+    Coupled<Ts...> operator()(const Coupled<Ts&...>& x) {
+        return std::apply([](const Ts&... xs) { return couple(xs...); }, x._elems);
     }
 };
 
@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "coupled.hpp"
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Solvers of the implicit problems of implicit Runge-Kutta stages, i.e.
+//
+//      y - c A(y) = r
+//
+// where A is the implicit term. These are called by the methods with
+//
+//      solver.solve(sys, y, r, c);
+//
+// where y holds an initial guess on entry, e.g. from the previous stage.
+
+// the implicit term is linear, and the system solves the problem directly
+struct LinearSolver {
+    template <typename Y>
+    LinearSolver(const Y&) {}
+
+    template <typename SYSTEM, typename Y>
+    void solve(SYSTEM& sys, Y& y, const Y& r, double c) {
+        sys.ImcA_div(y, r, c);
+    }
+};
+
+// no preconditioning
+struct IdentityPreconditioner {
+    template <typename Y>
+    void operator()(Y& out, const Y& in, double c) { out = in; }
+};
+
+// inner product and norm of arithmetic types and coupled objects
+template <typename Y>
+inline double _nk_dot(const Y& x, const Y& y) {
+    if constexpr (std::is_arithmetic_v<Y>) {
+        return x * y;
+    } else {
+        return dot(x, y);
+    }
+}
+
+template <typename Y>
+inline double _nk_norm(const Y& x) {
+    return std::sqrt(_nk_dot(x, x));
+}
+
+////////////////////////////////////////////////////////////////
+// Jacobian-free Newton-Krylov solver, for implicit terms that are not
+// linear and are only available through System::mul, i.e. A(y). The
+// Newton corrections solve (I - c J) d = r - y + c A(y) with restarted
+// GMRES, where the products with the Jacobian J of A are approximated by
+// finite differences of A, so that no matrix is assembled. GMRES uses
+// right preconditioning with the user preconditioner P, called as
+//
+//      precond(out, in, c)
+//
+// which should approximate out = (I - c J)^{-1} in, e.g. with the linear
+// part of A, and must be linear in 'in'. The preconditioner does not
+// change the residuals that GMRES minimises, so it can be changed without
+// changing the tolerances. The iteration stops when the norm of the
+// residual of the implicit problem is below atol + rtol * |r|, and each
+// GMRES solve stops when it has reduced the Newton residual by the
+// factor 'forcing'. The Krylov basis of 'krylov_dim' vectors and six
+// work registers are allocated on construction.
+template <typename Y, typename PRECOND = IdentityPreconditioner>
+class NewtonKrylov {
+private:
+    std::vector<Y>      _basis;
+    std::vector<double> _H; // Hessenberg matrix, column major
+    std::vector<double> _cs;
+    std::vector<double> _sn;
+    std::vector<double> _g;
+    std::vector<Y>      _work;
+
+    // aliases of the work registers
+    Y& _res() { return _work[0]; }
+    Y& _Ay() { return _work[1]; }
+    Y& _w() { return _work[2]; }
+    Y& _z() { return _work[3]; }
+    Y& _v() { return _work[4]; }
+    Y& _d() { return _work[5]; }
+
+public:
+    PRECOND     precond;
+    double      rtol        = 1e-10;
+    double      atol        = 1e-14;
+    double      forcing     = 1e-3;
+    std::size_t max_newton  = 20;
+    std::size_t max_restart = 10;
+
+    // statistics, accumulated over all solves
+    std::size_t nnewton = 0;
+    std::size_t nkrylov = 0;
+
+    NewtonKrylov(const Y& x, std::size_t krylov_dim = 20, PRECOND precond = PRECOND())
+        : _basis(krylov_dim + 1, x)
+        , _H((krylov_dim + 1) * krylov_dim)
+        , _cs(krylov_dim)
+        , _sn(krylov_dim)
+        , _g(krylov_dim + 1)
+        , _work(6, x)
+        , precond(precond) {}
+
+    template <typename SYSTEM>
+    void solve(SYSTEM& sys, Y& y, const Y& r, double c) {
+        auto& res = _res();
+        auto& Ay  = _Ay();
+
+        const double tol = atol + rtol * _nk_norm(r);
+        for (std::size_t k = 0; k != max_newton; k++) {
+            sys.mul(Ay, y);
+            res = r - y + c * Ay;
+            if (_nk_norm(res) <= tol)
+                return;
+            _gmres(sys, y, c);
+            nnewton++;
+        }
+
+        sys.mul(Ay, y);
+        res = r - y + c * Ay;
+        if (_nk_norm(res) > tol)
+            throw std::runtime_error("Newton-Krylov iteration did not converge");
+    }
+
+private:
+    // w = (I - c J) v, with the Jacobian at y by a forward difference,
+    // using the value A(y) in _Ay()
+    template <typename SYSTEM>
+    void _jvp(SYSTEM& sys, Y& w, const Y& v, const Y& y, double c) {
+        constexpr double sqrt_eps = 1.4901161193847656e-08;
+        const double     vnorm    = _nk_norm(v);
+        if (vnorm == 0) {
+            w = v;
+            return;
+        }
+        const double eps = sqrt_eps * (1 + _nk_norm(y)) / vnorm;
+        _z() = y + eps * v;
+        sys.mul(w, _z());
+        const double ceps = c / eps;
+        w = v - ceps * (w - _Ay());
+    }
+
+    // solve (I - c J) d = res with right preconditioned GMRES, and make
+    // the Newton update y = y + d
+    template <typename SYSTEM>
+    void _gmres(SYSTEM& sys, Y& y, double c) {
+        const std::size_t m   = _cs.size();
+        auto              H   = [&](std::size_t i, std::size_t j) -> double& { return _H[i + (m + 1) * j]; };
+        auto&             res = _res();
+        auto&             w   = _w();
+        auto&             v   = _v();
+        auto&             d   = _d();
+
+        const double tol = forcing * _nk_norm(res);
+
+        // the initial guess is zero, and the first residual is res
+        bool first = true;
+        for (std::size_t restart = 0; restart != max_restart; restart++) {
+            // residual of the current correction, held in v
+            if (first) {
+                v = res;
+            } else {
+                _jvp(sys, w, d, y, c);
+                v = res - w;
+            }
+
+            const double beta = _nk_norm(v);
+            if (beta <= tol)
+                break;
+            const double ibeta = 1 / beta;
+            _basis[0]          = ibeta * v;
+            std::fill(_g.begin(), _g.end(), 0.0);
+            _g[0] = beta;
+
+            // Arnoldi process with modified Gram-Schmidt
+            std::size_t j = 0;
+            while (j != m) {
+                precond(v, _basis[j], c);
+                _jvp(sys, w, v, y, c);
+                nkrylov++;
+                for (std::size_t i = 0; i <= j; i++) {
+                    const double h = _nk_dot(w, _basis[i]);
+                    H(i, j)        = h;
+                    w              = w - h * _basis[i];
+                }
+                const double h = _nk_norm(w);
+                H(j + 1, j)    = h;
+                if (h != 0) {
+                    const double ih = 1 / h;
+                    _basis[j + 1]   = ih * w;
+                }
+
+                // apply the previous rotations and eliminate H(j + 1, j)
+                for (std::size_t i = 0; i != j; i++) {
+                    const double a = H(i, j);
+                    const double b = H(i + 1, j);
+                    H(i, j)        = _cs[i] * a + _sn[i] * b;
+                    H(i + 1, j)    = -_sn[i] * a + _cs[i] * b;
+                }
+                const double a = H(j, j);
+                const double b = H(j + 1, j);
+                const double d = std::hypot(a, b);
+                _cs[j]         = a / d;
+                _sn[j]         = b / d;
+                H(j, j)        = d;
+                H(j + 1, j)    = 0;
+                _g[j + 1]      = -_sn[j] * _g[j];
+                _g[j]          = _cs[j] * _g[j];
+                j++;
+
+                if (std::fabs(_g[j]) <= tol || h == 0)
+                    break;
+            }
+
+            // solve the triangular system, overwriting g, and accumulate
+            // the correction sum_i g_i V_i in v
+            for (std::size_t i = j; i-- != 0;) {
+                for (std::size_t k = i + 1; k != j; k++)
+                    _g[i] -= H(i, k) * _g[k];
+                _g[i] /= H(i, i);
+            }
+            v = _g[0] * _basis[0];
+            for (std::size_t i = 1; i != j; i++)
+                v = v + _g[i] * _basis[i];
+
+            // the correction is P v, accumulated over the restarts
+            precond(w, v, c);
+            if (first) {
+                d = w;
+            } else {
+                d = d + w;
+            }
+            first = false;
+
+            if (std::fabs(_g[j]) <= tol)
+                break;
+        }
+
+        if (!first)
+            y = y + d;
+    }
+};
+}
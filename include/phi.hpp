@@ -0,0 +1,85 @@
+#pragma once
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// The functions phi_k of exponential integrators, with phi_0(z) = e^z and
+// phi_k(z) = (phi_{k-1}(z) - 1/(k-1)!) / z. The recurrence suffers from
+// cancellation for small |z|, so there phi_k(z) is evaluated with the
+// contour integral of Kassam and Trefethen, i.e. as the mean of phi_k
+// over a circle centred at z, on which the recurrence is accurate.
+
+// the recurrence, accurate away from the origin
+template <typename T>
+inline T _phi_recurrence(std::size_t k, T z) {
+    T      p = std::exp(z);
+    double f = 1; // (j - 1)!
+    for (std::size_t j = 1; j <= k; j++) {
+        p = (p - 1.0 / f) / z;
+        f *= j;
+    }
+    return p;
+}
+
+inline double phi(std::size_t k, double z) {
+    if (std::fabs(z) >= 1)
+        return _phi_recurrence(k, z);
+
+    // mean over points of a circle of radius 2, at least 1 away from the
+    // origin. For real z, the mean of the real part over the upper half
+    // of the circle is enough.
+    constexpr std::size_t M  = 32;
+    constexpr double      r  = 2;
+    constexpr double      pi = 3.14159265358979323846;
+    double                sum = 0;
+    for (std::size_t j = 0; j != M; j++) {
+        auto w = z + std::polar(r, pi * (j + 0.5) / M);
+        sum += std::real(_phi_recurrence(k, w));
+    }
+    return sum / M;
+}
+
+////////////////////////////////////////////////////////////////
+// Coefficients phi_k(c * lambda_i) of a diagonal linear operator with
+// eigenvalues lambda_i, e.g. in the Fourier basis. The coefficients are
+// computed on first use for each value of c and cached, as exponential
+// integrators use the same few values c = a * dt at every step. The
+// cache is cleared when it has more than 'max_entries' entries, so that
+// it stays bounded if the time step changes, e.g. on the last step.
+class PhiTable {
+private:
+    std::vector<double>                                           _lambdas;
+    std::map<std::pair<double, std::size_t>, std::vector<double>> _cache;
+    std::size_t                                                   _max_entries;
+
+public:
+    PhiTable(std::vector<double> lambdas, std::size_t max_entries = 16)
+        : _lambdas(std::move(lambdas))
+        , _max_entries(max_entries) {}
+
+    // number of eigenvalues
+    std::size_t size() const { return _lambdas.size(); }
+
+    // the coefficients phi_k(c * lambda_i)
+    const std::vector<double>& operator()(double c, std::size_t k) {
+        auto key = std::make_pair(c, k);
+        auto it  = _cache.find(key);
+        if (it != _cache.end())
+            return it->second;
+
+        if (_cache.size() >= _max_entries)
+            _cache.clear();
+
+        std::vector<double> coeffs(_lambdas.size());
+        for (std::size_t i = 0; i != _lambdas.size(); i++)
+            coeffs[i] = phi(k, c * _lambdas[i]);
+        return _cache.emplace(key, std::move(coeffs)).first->second;
+    }
+};
+}
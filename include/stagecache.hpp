@@ -1,10 +1,55 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
+#include "timerange.hpp"
+
 namespace Flows {
 
+////////////////////////////////////////////////////////////////
+// Stages of a single step, filled by a forward step and read by the
+// adjoint step, like an entry of a stage cache, e.g. when the stages are
+// formed again from a checkpoint. The stages are copied
+// into registers kept across steps, so that recording does not allocate.
+template <typename X>
+class _StepStages {
+private:
+    std::vector<X> _xs;
+    std::size_t    _n = 0;
+
+public:
+    void setup_step(double t, double dt) { _n = 0; }
+
+    void push_back(const X& x) {
+        if (_n < _xs.size()) {
+            _xs[_n] = x;
+        } else {
+            _xs.push_back(x);
+        }
+        _n++;
+    }
+
+    X* next_slot() {
+        if (_n == _xs.size()) {
+            if (_xs.empty())
+                return nullptr;
+            _xs.push_back(_xs.back());
+        }
+        return &_xs[_n++];
+    }
+
+    void close_step() {}
+
+    const X& operator[](std::size_t i) const { return _xs[i]; }
+};
+
 ////////////////////////////////////////////////////////////////
 /// Base class of stage caches
 template <typename X, std::size_t N>
@@ -12,6 +57,23 @@ struct AbstractStageCache {
     virtual void setup_step(double t, double dt) = 0;
     virtual void push_back(const X& x)           = 0;
     virtual void close_step()                    = 0;
+
+    // A writable slot for the next stage, which then holds the stage
+    // once the method has written it, or nullptr if stages must be
+    // pushed with push_back. The slot is valid until the next stage.
+    virtual X* next_slot() { return nullptr; }
+
+    // Local recomputation, see Flow::set_local_recomputation. With a
+    // function f, a single object is pushed at each step, the state at
+    // its beginning, and the stages of the step are formed again when
+    // read, with f(t, dt, x, stages) making the forward step from a copy
+    // x of the state. An empty function stores the stages again.
+    using RecomputeFunction = std::function<void(double, double, X&, _StepStages<X>&)>;
+
+    virtual void recompute_with(RecomputeFunction f) {
+        if (f)
+            throw std::invalid_argument("the stage cache does not support local recomputation");
+    }
 };
 
 ////////////////////////////////////////////////////////////////
@@ -21,8 +83,52 @@ struct NoOpStageCache : public AbstractStageCache<X, 0> {
     inline void setup_step(double t, double dt) override {}
     inline void push_back(const X& x) override {}
     inline void close_step() override {}
+    inline X*   next_slot() override { return nullptr; }
 };
 
+// checks whether a stage cache is a NoOpStageCache, so that
+// methods can skip work only needed to fill the cache
+template <typename T>
+struct _is_noop_cache : std::false_type {};
+
+template <typename X>
+struct _is_noop_cache<NoOpStageCache<X>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool _is_noop_cache_v = _is_noop_cache<std::decay_t<T>>::value;
+
+// checks whether a stage cache keeps the stages pushed to it, so that
+// methods forming the stages only for the cache can skip them. This is
+// false for NoOpStageCache and for caches recording the states only
+template <typename T>
+struct _stores_stages : std::bool_constant<!_is_noop_cache<T>::value> {};
+
+template <typename T>
+inline constexpr bool _stores_stages_v = _stores_stages<std::decay_t<T>>::value;
+
+// Register where a method writes the next stage: the next slot of the
+// cache, if it provides one, so that the stage is stored without a copy,
+// or the given register of the method, which _push_stage then pushes
+// into the cache. Caches without next_slot use the register.
+template <typename STAGECACHE, typename Y>
+inline auto _stage_slot(STAGECACHE& c, Y& reg, int) -> decltype(c.next_slot(), reg) {
+    if constexpr (!_is_noop_cache_v<STAGECACHE>) {
+        if (Y* slot = c.next_slot())
+            return *slot;
+    }
+    return reg;
+}
+
+template <typename STAGECACHE, typename Y>
+inline Y& _stage_slot(STAGECACHE& c, Y& reg, long) { return reg; }
+
+// push the stage, unless it was written into a slot of the cache
+template <typename STAGECACHE, typename Y>
+inline void _push_stage(STAGECACHE& c, const Y& stage, const Y& reg) {
+    if (&stage == &reg)
+        c.push_back(stage);
+}
+
 ////////////////////////////////////////////////////////////////
 // Provides a const view of N elements over a container. The
 // view is indexable using the subscript operator, but no bound
@@ -62,6 +168,13 @@ private:
     size_t       _i;
 
 public:
+    /* Iterator traits, dereferencing returns by value */
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = std::tuple<double, double, View<VEC_X, N>>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = value_type;
+
     /* Constructor */
     StageIterator(const VEC_T& ts, const VEC_T& dts, const VEC_X& xs, size_t i)
         : _ts(ts)
@@ -70,7 +183,7 @@ public:
         , _i(i) {}
 
     /* Dereferencing */
-    auto operator*() {
+    value_type operator*() const {
         return std::make_tuple(_ts[_i], _dts[_i], View<VEC_X, N>(_xs, _i * N));
     }
 
@@ -85,6 +198,9 @@ public:
     }
 
     /* Comparison */
+    bool operator==(const StageIterator<VEC_T, VEC_X, N>& other) const {
+        return other._i == _i;
+    }
     bool operator!=(const StageIterator<VEC_T, VEC_X, N>& other) const {
         return other._i != _i;
     }
@@ -110,19 +226,85 @@ public:
 };
 
 ////////////////////////////////////////////////////////////////
-// RAM STAGE CACHE
+// Stages of a RAMStageCache, with their times, indexable by the views.
+// With local recomputation, one state is stored per step, and the stages
+// of a step are formed again into a one step buffer when first read.
+template <typename X, std::size_t N>
+class _RAMStages {
+private:
+    static constexpr std::size_t _none = std::numeric_limits<std::size_t>::max();
+
+    using RecomputeFunction = typename AbstractStageCache<X, N>::RecomputeFunction;
+
+    RecomputeFunction      _recompute;
+    mutable std::vector<X> _x;
+    mutable _StepStages<X> _stages;
+    mutable std::size_t    _current = _none;
+
+public:
+    std::vector<X>      xs;
+    std::vector<double> ts;
+    std::vector<double> dts;
+
+    // objects stored per step
+    std::size_t stride() const { return _recompute ? 1 : N; }
+
+    void recompute_with(RecomputeFunction f) {
+        _recompute = std::move(f);
+        invalidate();
+    }
+
+    // the buffer no longer holds the stages of a stored step
+    void invalidate() { _current = _none; }
+
+    const X& operator[](std::size_t i) const {
+        if (!_recompute)
+            return xs[i];
+
+        const std::size_t step = i / N;
+        if (step != _current) {
+            if (_x.empty())
+                _x.push_back(xs[step]);
+            else
+                _x[0] = xs[step];
+            _recompute(ts[step], dts[step], _x[0], _stages);
+            _current = step;
+        }
+        return _stages[i % N];
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// RAM STAGE CACHE. The stages are kept in a contiguous array of slots,
+// which is reused after a call to 'reset', so that repeated forward and
+// adjoint integrations over the same horizon only allocate in the first
+// one. Methods may write stages directly into their slot, see next_slot,
+// and pushed stages are copied into their slot in place, so for containers
+// such as std::valarray, the memory of a slot is reused if the size of
+// the stages does not change. The slots for a given number of steps,
+// e.g. that of a TimeRange, can be reserved in advance, so that the
+// array does not grow during the first integration. With the local
+// recomputation of a Flow, the cache holds one state per step instead
+// of N stages, and the stages are formed again when read.
 template <typename X, std::size_t N>
 class RAMStageCache : public AbstractStageCache<X, N> {
 private:
-    std::vector<X>      _xs;
-    std::vector<double> _ts;
-    std::vector<double> _dts;
+    _RAMStages<X, N> _stages;
+    std::size_t      _nstages = 0;
+    std::size_t      _nsteps  = 0;
 
 public:
     // this prepares storage space for a new step
     void setup_step(double t, double dt) override {
-        _ts.push_back(t);
-        _dts.push_back(dt);
+        if (_nsteps < _stages.ts.size()) {
+            _stages.ts[_nsteps]  = t;
+            _stages.dts[_nsteps] = dt;
+        } else {
+            _stages.ts.push_back(t);
+            _stages.dts.push_back(dt);
+        }
+        _nsteps++;
+        _stages.invalidate();
     }
 
     // push a stage vector into the cache
@@ -134,23 +316,68 @@ public:
         // see e.g. RK4, we push Pair<A, B> object in the
         // method storage and not Pair<A&, B&> that is updated
         // at every step
-        _xs.push_back(x);
+        auto& xs = _stages.xs;
+        if (_nstages < xs.size()) {
+            xs[_nstages] = x;
+        } else {
+            xs.push_back(x);
+        }
+        _nstages++;
+    }
+
+    // the next slot, written in place by the method. The first slot
+    // is created by push_back, and new ones are copies of the last
+    X* next_slot() override {
+        auto& xs = _stages.xs;
+        if (_nstages == xs.size()) {
+            if (xs.empty())
+                return nullptr;
+            xs.push_back(xs.back());
+        }
+        return &xs[_nstages++];
     }
 
     // end-of-step function
     void close_step() override{ /* does nothing */ };
 
+    // store states and form the stages again, see Flow
+    void recompute_with(typename AbstractStageCache<X, N>::RecomputeFunction f) override {
+        _stages.recompute_with(std::move(f));
+    }
+
+    // reserve space for the given number of steps
+    void reserve(std::size_t nsteps) {
+        _stages.xs.reserve(nsteps * _stages.stride());
+        _stages.ts.reserve(nsteps);
+        _stages.dts.reserve(nsteps);
+    }
+
+    void reserve(const TimeRange& range) { reserve(range.len); }
+
+    // empty the cache, keeping the slots and their memory
+    void reset() {
+        _nstages = 0;
+        _nsteps  = 0;
+        _stages.invalidate();
+    }
+
+    // number of steps in the cache
+    std::size_t size() const { return _nsteps; }
+
+    // number of stored objects, stages or states
+    std::size_t stored() const { return _nstages; }
+
     // indexing (mainly for testing code)
     auto operator[](std::size_t i) {
-        return std::make_tuple(_ts[i], _dts[i], View<std::vector<X>, N>(_xs, i * N));
+        return std::make_tuple(_stages.ts[i], _stages.dts[i], View<_RAMStages<X, N>, N>(_stages, i * N));
     }
 
     // iteration support
     auto begin() const {
-        return StageIterator<std::vector<double>, std::vector<X>, N>(_ts, _dts, _xs, 0);
+        return StageIterator<std::vector<double>, _RAMStages<X, N>, N>(_stages.ts, _stages.dts, _stages, 0);
     }
     auto end() const {
-        return StageIterator<std::vector<double>, std::vector<X>, N>(_ts, _dts, _xs, _ts.size());
+        return StageIterator<std::vector<double>, _RAMStages<X, N>, N>(_stages.ts, _stages.dts, _stages, _nsteps);
     }
 };
-}
\ No newline at end of file
+}
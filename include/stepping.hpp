@@ -1,4 +1,9 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
 
 namespace Flows {
 
@@ -18,6 +23,90 @@ public:
     TimeStepConstant(double _dt) : dt (_dt) {}
 };
 
+////////////////////////////////////////////////////////////////
+// Adaptive time stepping, for methods with an embedded error
+// estimate, see steps/embeddedrk.hpp. Steps whose scaled error norm
+// is larger than one are rejected and retried with a smaller step.
+// The step size is selected by a PID controller, where the new step
+// is dt * safety * err_n^(-beta1/k) * err_(n-1)^(beta2/k) * err_(n-2)^(-beta3/k),
+// with k the order of the error estimate plus one. The default is the
+// PI controller of Gustafsson, with beta = (0.7, 0.4, 0). Setting
+// beta = (1, 0, 0) gives the classical elementary controller.
+class TimeStepAdaptive : public AbstractTimeStepping {
+private:
+    // scaled error norms of the last two accepted steps
+    double _err_1;
+    double _err_2;
+
+    // limit the factor and apply the safety factor
+    double _factor(double fac, double fac_max) const {
+        fac *= safety;
+        return std::min(fac_max, std::max(fac_min, fac));
+    }
+
+    // limit the magnitude of the step
+    double _limit(double dt) const {
+        return std::copysign(std::min(std::fabs(dt), dt_max), dt);
+    }
+
+public:
+    double rtol;
+    double atol;
+    double dt_init;
+    double dt_min   = 0;
+    double dt_max   = std::numeric_limits<double>::infinity();
+    double safety   = 0.9;
+    double fac_min  = 0.2;
+    double fac_max  = 5.0;
+    double beta[3]  = { 0.7, 0.4, 0.0 };
+
+    // statistics of the last integration
+    std::size_t naccepted = 0;
+    std::size_t nrejected = 0;
+
+    TimeStepAdaptive(double _rtol, double _atol, double _dt_init)
+        : _err_1(1)
+        , _err_2(1)
+        , rtol(_rtol)
+        , atol(_atol)
+        , dt_init(_dt_init) {}
+
+    // forget the error history, at the beginning of an integration
+    void restart() {
+        _err_1    = 1;
+        _err_2    = 1;
+        naccepted = 0;
+        nrejected = 0;
+    }
+
+    // new step after accepting a step of size dt with error norm err
+    double accept(double dt, double err, std::size_t k) {
+        // avoid division by zero for very smooth solutions
+        err = std::max(err, 1e-10);
+        double fac = std::pow(err, -beta[0] / k)
+                   * std::pow(_err_1, beta[1] / k)
+                   * std::pow(_err_2, -beta[2] / k);
+        _err_2 = _err_1;
+        _err_1 = err;
+        naccepted++;
+        return _limit(dt * _factor(fac, fac_max));
+    }
+
+    // new step after rejecting a step of size dt with error norm err.
+    // The step is never increased after a rejection. A step whose error
+    // is not finite, e.g. NaN from the right hand side, is not retried,
+    // as the step would then shrink until it vanishes.
+    double reject(double dt, double err, std::size_t k) {
+        nrejected++;
+        if (!std::isfinite(err))
+            throw std::runtime_error("error estimate is not finite");
+        double dt_new = dt * _factor(std::pow(err, -1.0 / k), 1.0);
+        if (std::fabs(dt_new) < dt_min)
+            throw std::runtime_error("time step below minimum");
+        return dt_new;
+    }
+};
+
 ////////////////////////////////////////////////////////////////
 // Integrate equations based on a stage cache
 class TimeStepFromStageCache : public AbstractTimeStepping {};
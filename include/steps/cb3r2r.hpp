@@ -3,91 +3,275 @@
 #include "../system.hpp"
 #include "../tableaux.hpp"
 #include "generic.hpp"
+#include <utility>
+#include <vector>
 
 namespace Flows {
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// define all 3R2R methods with a macro
-#define _DEFINE_CB3R2R_METHOD(_NAME, _NSTAGES, _TABLEAU)                         \
-                                                                                 \
-    template <typename Y, bool ISADJOINT = false>                                \
-    struct _NAME : public AbstractMethod<Y, 4, ISADJOINT> {                      \
-        _NAME(const Y& x)                                                        \
-            : AbstractMethod<Y, 4, ISADJOINT>(x) {}                              \
-    };                                                                           \
-                                                                                 \
-    template <typename Y, typename X, typename SYSTEM, typename STAGECACHE>      \
-    void step(_NAME<Y, false>& method,                                           \
-              SYSTEM&          sys,                                              \
-              double           t,                                                \
-              double           dt,                                               \
-              X&               x,                                                \
-              STAGECACHE&&     c) {                                                  \
-                                                                                 \
-        auto& y  = method.storage[0];                                            \
-        auto& z  = method.storage[1];                                            \
-        auto& w  = method.storage[2];                                            \
-        auto& Ay = method.storage[3];                                            \
-                                                                                 \
-        static const IMEXTableau<_NSTAGES> tab = _TABLEAU;                       \
-                                                                                 \
-        c.setup_step(t, dt);                                                     \
-                                                                                 \
-        for (int k = 0; k != _NSTAGES; k++) {                                    \
-            if (k == 0) {                                                        \
-                y = x;                                                           \
-            } else {                                                             \
-                auto c1 = (tab('I', 'a', k, k - 1) - tab('I', 'b', k - 1)) * dt; \
-                auto c2 = (tab('E', 'a', k, k - 1) - tab('E', 'b', k - 1)) * dt; \
-                y       = x + c1 * z + c2 * y;                                   \
-            }                                                                    \
-            sys.mul(Ay, y);                                                      \
-            sys.ImcA_div(z, Ay, tab('I', 'a', k, k) * dt);                            \
-            w = y + (tab('I', 'a', k, k) * dt) * z;                              \
-            c.push_back(w);                                                      \
-            sys(t + tab('E', 'c', k) * dt, w, y);                                \
-            x = x + (tab('I', 'b', k) * dt) * z + (tab('E', 'b', k) * dt) * y;   \
-        }                                                                        \
-        c.close_step();                                                          \
-    }                                                                            \
-                                                                                 \
-    template <typename Y, typename X, typename SYSTEM, typename STAGES>          \
-    void step(_NAME<Y, true>& method,                                            \
-              SYSTEM&         sys,                                               \
-              double          t,                                                 \
-              double          dt,                                                \
-              X&              x,                                                 \
-              STAGES&&        stages) {                                                 \
-                                                                                 \
-        auto& y = method.storage[0];                                             \
-        auto& z = method.storage[1];                                             \
-        auto& w = method.storage[2];                                             \
-                                                                                 \
-        static const IMEXTableau<_NSTAGES> tab = _TABLEAU;                       \
-                                                                                 \
-        y = 0;                                                                   \
-        z = 0;                                                                   \
-        w = 0;                                                                   \
-                                                                                 \
-        for (int k = _NSTAGES - 1; k >= 0; k--) {                                \
-            z = z + tab('I', 'b', k) * dt * x;                                   \
-            y = y + tab('E', 'b', k) * dt * x;                                   \
-            sys(t + tab('E', 'c', k) * dt, stages[k], y, w);                     \
-            z = z + tab('I', 'a', k, k) * dt * w;                                \
-            y = w;                                                               \
-            sys.ImcA_div(w, z, tab('I', 'a', k, k) * dt);                             \
-            sys.mul(z, w);                                                       \
-            y = y + z;                                                           \
-            x = x + y;                                                           \
-            if (k > 0) {                                                         \
-                z = (tab('I', 'a', k, k - 1) - tab('I', 'b', k - 1)) * dt * y;   \
-                y = (tab('E', 'a', k, k - 1) - tab('E', 'b', k - 1)) * dt * y;   \
-            }                                                                    \
-        }                                                                        \
+// define all 3R2R methods with a macro. The tableaux are constexpr, the stage loops
+// are unrolled and the coefficients are known at compile time, so that terms with zero
+// coefficients do not generate any loop over the state, see _scaled in coupled.hpp.
+
+// the term c * dt * v, dropped if c is zero
+#define _CB3R2R_TERM(_C, _V) _scaled<((_C) != 0)>((_C) * dt, _V)
+
+// the time t + c * dt
+#define _CB3R2R_TIME(_C) ((_C) != 0 ? t + (_C) * dt : t)
+
+// whether f(k) is true for any k in the sequence
+template <typename F, std::size_t... Ks>
+constexpr bool _any_stage(F f, std::index_sequence<Ks...>) {
+    return (f(std::integral_constant<std::size_t, Ks>()) || ... || false);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Adaptive variant, using the embedded weights of the tableau, see EmbeddedIMEXTableau.
+// The step is attempted without modifying the state, so it can be rejected: the state
+// is advanced into a register xn and the error estimate dt * sum_k (eI_k z_k + eE_k y_k)
+// is accumulated into a register err, in the same passes that update the state and
+// build the next stage. Until the first stage with nonzero weights, the old state is
+// read directly, so that no copy is needed. The product A y is formed in the register
+// of the stage, which is free until the stage is built, and xn takes the register of
+// A y of the fixed step method. Without record_stages, the stages are built in w and
+// err needs a fifth register, allocated on first use, for five registers in total.
+// With record_stages, the stages are built into registers of their own, which are
+// kept for the stage cache when the step is accepted, and err takes w instead, for
+// four registers plus one per stage, e.g. eight for CB3R2R_3E.
+template <const auto& TAB, std::size_t NSTAGES, typename METHOD, typename X, typename SYSTEM>
+double _cb3r2r_try_step(METHOD& method,
+                        SYSTEM& sys,
+                        double  t,
+                        double  dt,
+                        const X& x,
+                        double  atol,
+                        double  rtol) {
+
+    if (!method._record && method.storage.size() < 5)
+        method.storage.resize(5, method.storage[0]);
+    if (method._record && method._stages.size() < NSTAGES)
+        method._stages.resize(NSTAGES, method.storage[0]);
+
+    auto& y   = method.storage[0];
+    auto& z   = method.storage[1];
+    auto& w   = method.storage[2];
+    auto& xn  = method.storage[3];
+    auto& err = method._record ? w : method.storage[4];
+
+    const _Zero zero;
+
+    y = x;
+    _static_for<NSTAGES>([&](auto k) {
+        constexpr std::size_t K  = decltype(k)::value;
+        constexpr std::size_t K1 = K + 1 < NSTAGES ? K + 1 : K;
+        constexpr double      aI = TAB.template a<'I', K, K>();
+        constexpr double      bI = TAB.template b<'I', K>();
+        constexpr double      bE = TAB.template b<'E', K>();
+        constexpr double      eI = TAB.template e<'I', K>();
+        constexpr double      eE = TAB.template e<'E', K>();
+        constexpr double      cE = TAB.template c<'E', K>();
+        constexpr double      c1 = K + 1 < NSTAGES ? TAB.template a<'I', K1, K>() : 0.0;
+        constexpr double      c2 = K + 1 < NSTAGES ? TAB.template a<'E', K1, K>() : 0.0;
+
+        // whether xn and err have been written in a previous stage
+        constexpr bool has_xn = _any_stage([](auto j) {
+            return TAB.template b<'I', decltype(j)::value>() != 0
+                || TAB.template b<'E', decltype(j)::value>() != 0;
+        }, std::make_index_sequence<K>());
+        constexpr bool has_err = _any_stage([](auto j) {
+            return TAB.template e<'I', decltype(j)::value>() != 0
+                || TAB.template e<'E', decltype(j)::value>() != 0;
+        }, std::make_index_sequence<K>());
+
+        auto& s = method._record ? method._stages[K] : w;
+        sys.mul(s, y);
+        sys.ImcA_div(z, s, aI * dt);
+        s = y + _CB3R2R_TERM(aI, z);
+        sys(_CB3R2R_TIME(cE), s, y);
+
+        // update state and error, and build the next stage, in one pass
+        const auto& xs = _pick<!has_xn>(x, xn);
+        const auto& es = _pick<!has_err>(zero, err);
+        assign_all_if<bI != 0 || bE != 0, eI != 0 || eE != 0, K + 1 < NSTAGES>(
+            xn, xs + _CB3R2R_TERM(bI, z) + _CB3R2R_TERM(bE, y),
+            err, es + _CB3R2R_TERM(eI, z) + _CB3R2R_TERM(eE, y),
+            y, xs + _CB3R2R_TERM(c1, z) + _CB3R2R_TERM(c2, y));
+    });
+    method._has_stages = method._record;
+
+    return error_norm(err, x, xn, atol, rtol);
+}
+
+// Accept the last attempted step, whose state is the one of the error estimate. The
+// stages recorded in the attempt are pushed to the stage cache, if it keeps them. If
+// they were not recorded, e.g. when try_step is called outside of a Flow, the step
+// is made again.
+template <std::size_t NSTAGES, typename METHOD, typename SYSTEM, typename X, typename STAGECACHE>
+void _cb3r2r_accept_step(METHOD& method, SYSTEM& sys, double t, double dt, X& x, STAGECACHE&& c) {
+    if constexpr (_stores_stages_v<STAGECACHE>) {
+        if (!method._has_stages) {
+            step(method, sys, t, dt, x, std::forward<STAGECACHE>(c));
+            return;
+        }
+    }
+    c.setup_step(t, dt);
+    if constexpr (_stores_stages_v<STAGECACHE>) {
+        for (std::size_t k = 0; k != NSTAGES; k++)
+            c.push_back(method._stages[k]);
+    }
+    c.close_step();
+    x = method.storage[3];
+}
+
+#define _DEFINE_CB3R2R_METHOD(_NAME, _NSTAGES, _TABLEAU)                            \
+                                                                                    \
+    template <typename Y, bool ISADJOINT = false>                                   \
+    struct _NAME : public AbstractMethod<Y, 4, ISADJOINT> {                         \
+        /* exponent used by the step size controller */                             \
+        static constexpr std::size_t error_exponent                                 \
+            = _TABLEAU.embedded_order + 1;                                          \
+                                                                                    \
+        /* stages of the last attempted step, if recorded */                        \
+        std::vector<Y> _stages;                                                     \
+        bool           _record     = false;                                         \
+        bool           _has_stages = false;                                         \
+                                                                                    \
+        _NAME(const Y& x)                                                           \
+            : AbstractMethod<Y, 4, ISADJOINT>(x) {}                                 \
+                                                                                    \
+        /* nothing to reset between integrations */                                 \
+        void restart() {}                                                           \
+                                                                                    \
+        /* keep the stages of the attempted steps, for a stage cache */             \
+        bool record_stages(bool on) { return std::exchange(_record, on); }          \
+    };                                                                              \
+                                                                                    \
+    template <typename Y, typename X, typename SYSTEM>                              \
+    double try_step(_NAME<Y, false>& method,                                        \
+                    SYSTEM&          sys,                                           \
+                    double           t,                                             \
+                    double           dt,                                            \
+                    const X&         x,                                             \
+                    double           atol,                                          \
+                    double           rtol) {                                        \
+        return _cb3r2r_try_step<_TABLEAU, _NSTAGES>(                                \
+            method, sys, t, dt, x, atol, rtol);                                     \
+    }                                                                               \
+                                                                                    \
+    template <typename Y, typename SYSTEM, typename X, typename STAGECACHE>         \
+    void accept_step(_NAME<Y, false>& method,                                       \
+                     SYSTEM&          sys,                                          \
+                     double           t,                                            \
+                     double           dt,                                           \
+                     X&               x,                                            \
+                     STAGECACHE&&     c) {                                          \
+        _cb3r2r_accept_step<_NSTAGES>(                                              \
+            method, sys, t, dt, x, std::forward<STAGECACHE>(c));                    \
+    }                                                                               \
+                                                                                    \
+    template <typename Y, typename X, typename SYSTEM, typename STAGECACHE>         \
+    void step(_NAME<Y, false>& method,                                              \
+              SYSTEM&          sys,                                                 \
+              double           t,                                                   \
+              double           dt,                                                  \
+              X&               x,                                                   \
+              STAGECACHE&&     c) {                                                 \
+                                                                                    \
+        auto& y  = method.storage[0];                                               \
+        auto& z  = method.storage[1];                                               \
+        auto& w  = method.storage[2];                                               \
+        auto& Ay = method.storage[3];                                               \
+                                                                                    \
+        constexpr const auto& tab = _TABLEAU;                                       \
+                                                                                    \
+        c.setup_step(t, dt);                                                        \
+                                                                                    \
+        y = x;                                                                      \
+        _static_for<_NSTAGES>([&](auto k) {                                         \
+            constexpr std::size_t K = decltype(k)::value;                           \
+            constexpr double aI = tab.a<'I', K, K>();                               \
+            constexpr double bI = tab.b<'I', K>();                                  \
+            constexpr double bE = tab.b<'E', K>();                                  \
+            constexpr double cE = tab.c<'E', K>();                                  \
+                                                                                    \
+            sys.mul(Ay, y);                                                         \
+            sys.ImcA_div(z, Ay, aI * dt);                                           \
+            auto& s = _stage_slot(c, w, 0);                                         \
+            s       = y + _CB3R2R_TERM(aI, z);                                      \
+            _push_stage(c, s, w);                                                   \
+            sys(_CB3R2R_TIME(cE), s, y);                                            \
+                                                                                    \
+            if constexpr (K == _NSTAGES - 1) {                                      \
+                if constexpr (bI != 0 || bE != 0)                                   \
+                    x = x + _CB3R2R_TERM(bI, z) + _CB3R2R_TERM(bE, y);              \
+            } else {                                                                \
+                /* update the state and build the next stage in one pass */         \
+                constexpr double c1 = tab.a<'I', K + 1, K>();                       \
+                constexpr double c2 = tab.a<'E', K + 1, K>();                       \
+                if constexpr (bI != 0 || bE != 0) {                                 \
+                    assign_all(x, x + _CB3R2R_TERM(bI, z) + _CB3R2R_TERM(bE, y),    \
+                               y, x + _CB3R2R_TERM(c1, z) + _CB3R2R_TERM(c2, y));   \
+                } else {                                                            \
+                    y = x + _CB3R2R_TERM(c1, z) + _CB3R2R_TERM(c2, y);              \
+                }                                                                   \
+            }                                                                       \
+        });                                                                         \
+        c.close_step();                                                             \
+    }                                                                               \
+                                                                                    \
+    template <typename Y, typename X, typename SYSTEM, typename STAGES>             \
+    void step(_NAME<Y, true>& method,                                               \
+              SYSTEM&         sys,                                                  \
+              double          t,                                                    \
+              double          dt,                                                   \
+              X&              x,                                                    \
+              STAGES&&        stages) {                                             \
+                                                                                    \
+        auto& y = method.storage[0];                                                \
+        auto& z = method.storage[1];                                                \
+        auto& w = method.storage[2];                                                \
+                                                                                    \
+        constexpr const auto& tab = _TABLEAU;                                       \
+                                                                                    \
+        {                                                                           \
+            constexpr double bI = tab.b<'I', _NSTAGES - 1>();                       \
+            constexpr double bE = tab.b<'E', _NSTAGES - 1>();                       \
+            assign_all(z, _CB3R2R_TERM(bI, x), y, _CB3R2R_TERM(bE, x));             \
+        }                                                                           \
+                                                                                    \
+        _static_for<_NSTAGES>([&](auto k) {                                         \
+            constexpr std::size_t K  = _NSTAGES - 1 - decltype(k)::value;           \
+            constexpr double      aI = tab.a<'I', K, K>();                          \
+            constexpr double      cE = tab.c<'E', K>();                             \
+                                                                                    \
+            sys(_CB3R2R_TIME(cE), stages[K], y, w);                                 \
+            if constexpr (aI != 0) {                                                \
+                assign_all(z, z + _CB3R2R_TERM(aI, w), y, w);                       \
+            } else {                                                                \
+                y = w;                                                              \
+            }                                                                       \
+            sys.ImcA_div(w, z, aI * dt);                                            \
+            sys.mul(z, w);                                                          \
+                                                                                    \
+            if constexpr (K == 0) {                                                 \
+                x = x + y + z;                                                      \
+            } else {                                                                \
+                /* update the state and the adjoint of the previous stage */        \
+                constexpr double bI = tab.b<'I', K - 1>();                          \
+                constexpr double bE = tab.b<'E', K - 1>();                          \
+                constexpr double c1 = tab.a<'I', K, K - 1>();                       \
+                constexpr double c2 = tab.a<'E', K, K - 1>();                       \
+                assign_all(x, x + y + z,                                            \
+                           z, _CB3R2R_TERM(c1, y + z) + _CB3R2R_TERM(bI, x),        \
+                           y, _CB3R2R_TERM(c2, y + z) + _CB3R2R_TERM(bE, x));       \
+            }                                                                       \
+        });                                                                         \
     }
 
 _DEFINE_CB3R2R_METHOD(CB3R2R_3E, 4, CB3e)
 _DEFINE_CB3R2R_METHOD(CB3R2R_2, 3, CB2)
 
 #undef _DEFINE_CB3R2R_METHOD
-}
\ No newline at end of file
+#undef _CB3R2R_TERM
+#undef _CB3R2R_TIME
+}
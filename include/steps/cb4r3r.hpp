@@ -1,127 +1,173 @@
 #pragma once
-#include <array>
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
 #include "generic.hpp"
-#include "system.hpp"
-#include "stagecache.hpp"
+#include <cstddef>
 
 namespace Flows {
 
 ////////////////////////////////////////////////////////////////
-// Classical fourth order Runge-Kutta method
-template <typename X>
-struct RK4 : public AbstractMethod<X, 5> {
-    RK4(const X& x) : AbstractMethod<X, 5>(x) {}
-};
-
-template <typename X, typename SYSTEM, typename STAGECACHE>
-void step(const RK4<X>& method,
-          const SYSTEM& sys,
-          double t,
-          double dt,
-          X& x,
-          STAGECACHE& c) {
-
-    // aliases
-    auto k1 = method.storage[0];
-    auto k2 = method.storage[1];
-    auto k3 = method.storage[2];
-    auto k4 = method.storage[3];
-    auto  y = method.storage[4];
-
-    // prepare cache for new step
-    c.setup(t, dt);
-
-    // stages
-    y = x          ; sys(t       , y, k1); c.push<0>(y);
-    y = x + dt*k1/2; sys(t + dt/2, y, k2); c.push<1>(y);
-    y = x + dt*k2/2; sys(t + dt/2, y, k3); c.push<2>(y);
-    y = x + dt*k3  ; sys(t + dt  , y, k4); c.push<3>(y);
-
-    // wrap up
-    x = x + dt/6 * (k1 + 2*k2 + 2*k3 + k4);
-};
+// Low storage IMEX methods of Cavaglieri and Bewley with the 4R3R structure,
+// where a_{ij} = b_j for j < i - 2, for both the implicit and explicit parts.
+// The stage i then only depends on the stages i - 1 and i - 2, besides the
+// partial sums of the solution, and the method needs four registers: the
+// stage derivative of the implicit term, and three registers holding, at the
+// start of each stage, the current stage, the partial value of the next stage
+// and scratch space. These roles rotate from one stage to the next, so that
+// registers are never copied, and the state is updated, the next stage is
+// completed and the one after is started in a single pass.
 
+// whether the tableau has the 4R3R structure
+template <std::size_t N>
+constexpr bool _is_4r3r(const IMEXTableau<N>& tab) {
+    for (std::size_t i = 0; i != N; i++)
+        for (std::size_t j = 0; j + 2 < i; j++)
+            if (tab('I', 'a', i, j) != tab('I', 'b', j) || tab('E', 'a', i, j) != tab('E', 'b', j))
+                return false;
+    return true;
 }
 
-    template <size_t N>
-    void step(X& x, double t, double dt, IMEXTableau<N>& tab, RK_3R2R) noexcept {
-        // make aliases
-        X& y = this->storage[0];
-        X& z = this->storage[1];
-        X& w = this->storage[2];
-
-        // tableau stages
-        for (int k = 0; k != N; k++) {
-            if (k == 0) {
-                y = x;
-            } else {
-                y = x + (tab('I', 'a', k, k-1) - tab('I', 'b', k-1))*dt*z +
-                        (tab('E', 'a', k, k-1) - tab('E', 'b', k-1))*dt*y;
-            }
-            this->rhs.imterm(z, y);
-            this->rhs.imterm(tab('I', 'a', k, k)*dt, z, z);
-            w = y + tab('I', 'a', k, k)*dt*z;
-            this->rhs.exterm(t + tab('E', 'c', k)*dt, w, y);
-            x = x + tab('I', 'b', k)*dt*z + tab('E', 'b', k)*dt*y;
-        }
+// coefficient a_{ij} of the tableau, or zero for stages past the last one
+template <char IMEX, std::size_t I, std::size_t J, std::size_t N>
+constexpr double _cb4r3r_a(const IMEXTableau<N>& tab) {
+    if constexpr (I < N) {
+        return tab.template a<IMEX, I, J>();
+    } else {
+        return 0.0;
     }
+}
 
-    // specialisation of step for RK_4R3R
-    template <size_t N>
-    void step(X &x, double t, double dt, IMEXTableau<N> &tab, RK_4R3R) noexcept {
-        // make aliases
-        X& y  = this->storage[0];
-        X& zi = this->storage[1];
-        X& ze = this->storage[2];
-        X& w  = this->storage[3];
+// the term c * dt * v, or zero if the coefficient is zero
+#define _CB4R3R_TERM(_C, _V) _scaled<((_C) != 0)>((_C) * dt, _V)
 
-        // tableau stages
-        for (int k = 0; k != N; k++) {
-            if (k == 0) {
-                 y = x;
-                zi = x;
-                ze = x;
-            } else {
-                ze = y + tab('E', 'a', k, k-1)*dt*ze;
-                if (k < N-1) {
-                    y = x + (tab('I', 'a', k+1, k-1) - tab('I', 'b', k-1))*dt*zi +
-                            (tab('E', 'a', k+1, k-1) - tab('I', 'b', k-1))/tab('E', 'a', k, k-1)*(ze - y);
-                }
-                ze = ze + tab('I', 'a', k, k-1)*dt*zi;
-            }
-            this->rhs.imterm(w, ze);
-            this->rhs.imterm(tab('I', 'a', k, k)*dt, w, zi);
-            w = ze + tab('I', 'a', k, k)*dt*zi;
-            this->rhs.exterm(t + tab('E', 'c', k)*dt, w, ze);
-            x = x + tab('I', 'b', k)*dt*zi + tab('E', 'b', k)*dt*ze;
-        }
-    }
+// the time t + c * dt
+#define _CB4R3R_TIME(_C) ((_C) != 0 ? t + (_C) * dt : t)
 
+#define _DEFINE_CB4R3R_METHOD(_NAME, _NSTAGES, _TABLEAU)                            \
+                                                                                    \
+    template <typename Y, bool ISADJOINT = false>                                   \
+    struct _NAME : public AbstractMethod<Y, 4, ISADJOINT> {                         \
+        static_assert(_is_4r3r(_TABLEAU), "the tableau must be of 4R3R type");      \
+                                                                                    \
+        _NAME(const Y& x)                                                           \
+            : AbstractMethod<Y, 4, ISADJOINT>(x) {}                                 \
+    };                                                                              \
+                                                                                    \
+    template <typename Y, typename X, typename SYSTEM, typename STAGECACHE>         \
+    void step(_NAME<Y, false>& method,                                              \
+              SYSTEM&          sys,                                                 \
+              double           t,                                                   \
+              double           dt,                                                  \
+              X&               x,                                                   \
+              STAGECACHE&&     c) {                                                 \
+                                                                                    \
+        auto& z = method.storage[3];                                                \
+                                                                                    \
+        constexpr const auto& tab = _TABLEAU;                                       \
+                                                                                    \
+        c.setup_step(t, dt);                                                        \
+                                                                                    \
+        method.storage[0] = x;                                                      \
+        _static_for<_NSTAGES>([&](auto k) {                                         \
+            constexpr std::size_t K  = decltype(k)::value;                          \
+            constexpr double      aI = tab.a<'I', K, K>();                          \
+            constexpr double      bI = tab.b<'I', K>();                             \
+            constexpr double      bE = tab.b<'E', K>();                             \
+            constexpr double      cE = tab.c<'E', K>();                             \
+            constexpr double      c1 = _cb4r3r_a<'I', K + 1, K>(tab);               \
+            constexpr double      c2 = _cb4r3r_a<'E', K + 1, K>(tab);               \
+            constexpr double      c3 = _cb4r3r_a<'I', K + 2, K>(tab);               \
+            constexpr double      c4 = _cb4r3r_a<'E', K + 2, K>(tab);               \
+                                                                                    \
+            /* current stage, next stage and scratch space */                       \
+            auto& y = method.storage[K % 3];                                        \
+            auto& p = method.storage[(K + 1) % 3];                                  \
+            auto& w = method.storage[(K + 2) % 3];                                  \
+                                                                                    \
+            sys.mul(w, y);                                                          \
+            sys.ImcA_div(z, w, aI * dt);                                            \
+            auto& s = _stage_slot(c, w, 0);                                         \
+            s       = y + _CB4R3R_TERM(aI, z);                                      \
+            _push_stage(c, s, w);                                                   \
+            sys(_CB4R3R_TIME(cE), s, y);                                            \
+                                                                                    \
+            /* update the state, complete the next stage and start the one */       \
+            /* after, in one pass. The next stage starts from the state at */       \
+            /* the first stage */                                                   \
+            const auto& ps = _pick<K == 0>(x, p);                                   \
+            assign_all_if<bI != 0 || bE != 0, K + 1 < _NSTAGES, K + 2 < _NSTAGES>(  \
+                x, x + _CB4R3R_TERM(bI, z) + _CB4R3R_TERM(bE, y),                   \
+                p, ps + _CB4R3R_TERM(c1, z) + _CB4R3R_TERM(c2, y),                  \
+                w, x + _CB4R3R_TERM(c3, z) + _CB4R3R_TERM(c4, y));                  \
+        });                                                                         \
+        c.close_step();                                                             \
+    }                                                                               \
+                                                                                    \
+    template <typename Y, typename X, typename SYSTEM, typename STAGES>             \
+    void step(_NAME<Y, true>& method,                                               \
+              SYSTEM&         sys,                                                  \
+              double          t,                                                    \
+              double          dt,                                                   \
+              X&              x,                                                    \
+              STAGES&&        stages) {                                             \
+                                                                                    \
+        auto& y = method.storage[0];                                                \
+        auto& z = method.storage[1];                                                \
+        auto& w = method.storage[2];                                                \
+        auto& p = method.storage[3];                                                \
+                                                                                    \
+        constexpr const auto& tab = _TABLEAU;                                       \
+                                                                                    \
+        {                                                                           \
+            constexpr double bI = tab.b<'I', _NSTAGES - 1>();                       \
+            constexpr double bE = tab.b<'E', _NSTAGES - 1>();                       \
+            assign_all(z, _CB4R3R_TERM(bI, x), y, _CB4R3R_TERM(bE, x));             \
+        }                                                                           \
+                                                                                    \
+        /* p holds the adjoint of the stage after the current one, which is */     \
+        /* added to the state one stage later than in CB3R2R, because it    */     \
+        /* also enters the adjoint of the stage before the current one      */     \
+        const _Zero zero;                                                           \
+        _static_for<_NSTAGES>([&](auto k) {                                         \
+            constexpr std::size_t K  = _NSTAGES - 1 - decltype(k)::value;           \
+            constexpr double      aI = tab.a<'I', K, K>();                          \
+            constexpr double      cE = tab.c<'E', K>();                             \
+                                                                                    \
+            sys(_CB4R3R_TIME(cE), stages[K], y, w);                                 \
+            if constexpr (aI != 0) {                                                \
+                assign_all(z, z + _CB4R3R_TERM(aI, w), y, w);                       \
+            } else {                                                                \
+                y = w;                                                              \
+            }                                                                       \
+            sys.ImcA_div(w, z, aI * dt);                                            \
+            sys.mul(z, w);                                                          \
+                                                                                    \
+            const auto& ps = _pick<K == _NSTAGES - 1>(zero, p);                     \
+            if constexpr (K == 0) {                                                 \
+                x = x + ps + y + z;                                                 \
+            } else {                                                                \
+                /* update the state and the adjoint of the previous stage */        \
+                constexpr double bI = tab.b<'I', K - 1>();                          \
+                constexpr double bE = tab.b<'E', K - 1>();                          \
+                constexpr double c1 = tab.a<'I', K, K - 1>();                       \
+                constexpr double c2 = tab.a<'E', K, K - 1>();                       \
+                constexpr double c3 = _cb4r3r_a<'I', K + 1, K - 1>(tab);            \
+                constexpr double c4 = _cb4r3r_a<'E', K + 1, K - 1>(tab);            \
+                assign_all(x, x + ps,                                               \
+                           z, _CB4R3R_TERM(c1, y + z) + _CB4R3R_TERM(c3, ps)        \
+                                  + _CB4R3R_TERM(bI, x),                            \
+                           y, _CB4R3R_TERM(c2, y + z) + _CB4R3R_TERM(c4, ps)        \
+                                  + _CB4R3R_TERM(bE, x),                            \
+                           p, y + z);                                               \
+            }                                                                       \
+        });                                                                         \
+    }
 
-    // second order method
-Tableau<3> _CB2I = {{0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                     0.0 / 1.0, 2.0 / 5.0, 0.0 / 1.0,
-                     0.0 / 1.0, 5.0 / 6.0, 1.0 / 6.0},
-                    {0.0 / 1.0, 5.0 / 6.0, 1.0 / 6.0},
-                    {0.0 / 1.0, 2.0 / 5.0, 1.0 / 1.0}};
-Tableau<3> _CB2E = {{0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                     2.0 / 5.0, 0.0 / 1.0, 0.0 / 1.0,
-                     0.0 / 1.0, 1.0 / 1.0, 0.0 / 1.0},
-                    {0.0 / 1.0, 5.0 / 6.0, 1.0 / 6.0},
-                    {0.0 / 1.0, 2.0 / 5.0, 1.0 / 1.0}};
-IMEXTableau<3> CB2{_CB2I, _CB2E};
+_DEFINE_CB4R3R_METHOD(CB4R3R_4, 6, CB4)
 
-// third order method
-Tableau<4> _CB3eI = {{0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                      0.0 / 1.0, 1.0 / 3.0, 0.0 / 1.0, 0.0 / 1.0,
-                      0.0 / 1.0, 1.0 / 2.0, 1.0 / 2.0, 0.0 / 1.0,
-                      0.0 / 1.0, 3.0 / 4.0, -1.0 / 4.0, 1.0 / 2.0},
-                     {0.0 / 1.0, 3.0 / 4.0, -1.0 / 4.0, 1.0 / 2.0},
-                     {0.0 / 1.0, 1.0 / 3.0, 1.0 / 1.0, 1.0 / 1.0}};
-Tableau<4> _CB3eE = {{0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                      1.0 / 3.0, 0.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                      0.0 / 1.0, 1.0 / 1.0, 0.0 / 1.0, 0.0 / 1.0,
-                      0.0 / 1.0, 3.0 / 4.0, 1.0 / 4.0, 0.0 / 1.0},
-                     {0.0 / 1.0, 3.0 / 4.0, -1.0 / 4.0, 1.0 / 2.0},
-                     {0.0 / 1.0, 1.0 / 3.0, 1.0 / 1.0, 1.0 / 1.0}};
-IMEXTableau<4> CB3e{_CB3eI, _CB3eE};
\ No newline at end of file
+#undef _DEFINE_CB4R3R_METHOD
+#undef _CB4R3R_TERM
+#undef _CB4R3R_TIME
+}
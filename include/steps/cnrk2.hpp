@@ -7,7 +7,8 @@
 namespace Flows {
 
 ////////////////////////////////////////////////////////////////
-// Crank-Nicolson Runge-Kutta method
+// Crank-Nicolson Runge-Kutta method. The stages pushed to the
+// stage cache are the initial state and the predictor.
 template <typename Y, bool ISADJOINT = false>
 struct CNRK2 : public AbstractMethod<Y, 5, ISADJOINT> {
     CNRK2(const Y& x)
@@ -48,4 +49,38 @@ void step(CNRK2<Y, false>& method,
 
     c.close_step();
 };
+
+// Backward integration. This is the discrete adjoint of the forward step,
+// with the explicit term linearised about the two stages, the initial
+// state and the predictor, and the implicit term assumed self-adjoint.
+template <typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(CNRK2<Y, true>& method,
+          SYSTEM&         sys,
+          double          t,
+          double          dt,
+          X&              x,
+          STAGES&&        stages) {
+
+    // aliases
+    auto& k1 = method.storage[0];
+    auto& k2 = method.storage[1];
+    auto& k3 = method.storage[2];
+    auto& k4 = method.storage[3];
+    auto& k5 = method.storage[4];
+
+    // adjoint of the corrector
+    sys.ImcA_div(k1, x, 0.5 * dt);
+    sys(t + dt, stages[1], k1, k2);
+
+    // adjoint of the predictor
+    k3 = 0.5 * dt * k2;
+    sys.ImcA_div(k4, k3, 0.5 * dt);
+
+    // wrap up
+    k3 = 0.5 * dt * k1 + dt * k4;
+    sys(t, stages[0], k3, k5);
+    k3 = k1 + k4;
+    sys.ImcA_mul(k2, k3, -0.5 * dt);
+    x = k2 + k5;
+};
 }
\ No newline at end of file
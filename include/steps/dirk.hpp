@@ -0,0 +1,100 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../newtonkrylov.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "generic.hpp"
+#include <cstddef>
+#include <utility>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Additive diagonally implicit Runge-Kutta methods, e.g.
+//
+//      auto m = DIRK<CB3e, Y>(x);
+//      auto m = DIRK<CB4, Y, NewtonKrylov<Y, P>>(x);
+//
+// using the implicit part of an IMEXTableau for the implicit term and
+// the explicit part for the explicit term. Unlike the low storage 3R2R
+// and 4R3R methods, which rely on the linearity of the implicit term,
+// all stage derivatives are kept, and the implicit term only needs to
+// be evaluated by System::mul. The implicit problem of each stage is
+// solved by the stage solver of the method, see newtonkrylov.hpp, with
+// LinearSolver calling ImcA_div and NewtonKrylov handling a nonlinear
+// implicit term. The initial guess of each stage extrapolates from the
+// implicit term of the previous stage. There is no adjoint method, as
+// that of a nonlinear implicit term needs its transposed Jacobian.
+template <const auto& TAB, typename Y, typename SOLVER = LinearSolver>
+struct DIRK : public AbstractMethod<Y, 2 * std::decay_t<decltype(TAB)>::nstages + 2, false> {
+    static constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    SOLVER solver;
+
+    template <typename... ARGS>
+    DIRK(const Y& x, ARGS&&... args)
+        : AbstractMethod<Y, 2 * N + 2, false>(x)
+        , solver(x, std::forward<ARGS>(args)...) {}
+};
+
+// r = x + dt sum_j (aE_ij F_j + aI_ij G_j), for j < i
+template <const auto& TAB, std::size_t I, typename Y, typename X, typename F, typename G, std::size_t... Js>
+inline void _dirk_rhs(Y& r, const X& x, double dt, F&& f, G&& g, std::index_sequence<Js...>) {
+    r = (x + ... + (_scaled<(TAB.template a<'E', I, Js>() != 0)>(TAB.template a<'E', I, Js>() * dt, f(Js))
+                    + _scaled<(TAB.template a<'I', I, Js>() != 0)>(TAB.template a<'I', I, Js>() * dt, g(Js))));
+}
+
+// x = x + dt sum_j (bE_j F_j + bI_j G_j)
+template <const auto& TAB, typename X, typename F, typename G, std::size_t... Js>
+inline void _dirk_solution(X& x, double dt, F&& f, G&& g, std::index_sequence<Js...>) {
+    x = (x + ... + (_scaled<(TAB.template b<'E', Js>() != 0)>(TAB.template b<'E', Js>() * dt, f(Js))
+                    + _scaled<(TAB.template b<'I', Js>() != 0)>(TAB.template b<'I', Js>() * dt, g(Js))));
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename SOLVER, typename X, typename SYSTEM, typename STAGECACHE>
+void step(DIRK<TAB, Y, SOLVER>& method,
+          SYSTEM&               sys,
+          double                t,
+          double                dt,
+          X&                    x,
+          STAGECACHE&&          c) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& y = method.storage[0];
+    auto& r = method.storage[1];
+    auto  f = [&](std::size_t j) -> Y& { return method.storage[2 + j]; };
+    auto  g = [&](std::size_t j) -> Y& { return method.storage[2 + N + j]; };
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t I  = decltype(i)::value;
+        constexpr double      aI = TAB.template a<'I', I, I>();
+
+        if constexpr (aI == 0) {
+            _dirk_rhs<TAB, I>(y, x, dt, f, g, std::make_index_sequence<I>());
+        } else {
+            _dirk_rhs<TAB, I>(r, x, dt, f, g, std::make_index_sequence<I>());
+            if constexpr (I == 0) {
+                y = r;
+            } else {
+                y = r + (aI * dt) * g(I - 1);
+            }
+            method.solver.solve(sys, y, r, aI * dt);
+        }
+
+        c.push_back(y);
+        sys(t + TAB.template c<'E', I>() * dt, y, f(I));
+        sys.mul(g(I), y);
+    });
+
+    // wrap up
+    _dirk_solution<TAB>(x, dt, f, g, std::make_index_sequence<N>());
+    c.close_step();
+}
+}
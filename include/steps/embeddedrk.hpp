@@ -0,0 +1,159 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "explicitrk.hpp"
+#include "generic.hpp"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Embedded Runge-Kutta pairs for adaptive time stepping, e.g.
+//
+//      auto m = EmbeddedRK<DP54, Y>(x);
+//
+// to be used with TimeStepAdaptive. A step is first attempted with
+// try_step, which evaluates the stages and returns the scaled norm of
+// the error estimate. The step is then either accepted with accept_step,
+// which updates the state and pushes the stages to the stage cache, or
+// rejected, and attempted again with a smaller step. The first stage is
+// reused when a rejected step is attempted again and, for pairs with the
+// FSAL property, the last stage is reused as the first stage of the next
+// step. The adjoint method is the discrete adjoint of the higher order
+// solution, see ExplicitRK, and runs over the stages of accepted steps.
+template <const auto& TAB, typename Y, bool ISADJOINT = false>
+struct EmbeddedRK;
+
+template <const auto& TAB, typename Y>
+struct EmbeddedRK<TAB, Y, false>
+    : public AbstractMethod<Y, std::decay_t<decltype(TAB)>::nstages + 1, false> {
+    static_assert(_is_explicit(TAB), "the tableau must be explicit");
+
+    static constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // exponent used by the step size controller
+    static constexpr std::size_t error_exponent = TAB.embedded_order + 1;
+
+    // number of evaluations of the right hand side
+    std::size_t nevals;
+
+    // registers of the first and last stage derivatives, which are
+    // swapped after each accepted step of a FSAL pair, and whether
+    // the first stage derivative is that of the current state
+    std::size_t _first;
+    std::size_t _last;
+    bool        _has_first;
+
+    EmbeddedRK(const Y& x)
+        : AbstractMethod<Y, N + 1, false>(x)
+        , nevals(0)
+        , _first(1)
+        , _last(N)
+        , _has_first(false) {}
+
+    // call when the state is modified outside of accept_step,
+    // e.g. at the beginning of an integration
+    void restart() {
+        _has_first = false;
+        nevals     = 0;
+    }
+
+    // stage derivative k_j
+    Y& _k(std::size_t j) {
+        return this->storage[j == 0 ? _first : j == N - 1 ? _last : 1 + j];
+    }
+};
+
+template <const auto& TAB, typename Y>
+struct EmbeddedRK<TAB, Y, true> : public ExplicitRK<TAB, Y, true> {
+    EmbeddedRK(const Y& x)
+        : ExplicitRK<TAB, Y, true>(x) {}
+};
+
+// scaled norm of the error estimate dt * sum_j e_j k_j
+template <const auto& TAB, typename X, typename Y, typename K, std::size_t... Js>
+inline double _erk_error_norm(const X& x, const Y& y, double dt, K&& k,
+    double atol, double rtol, std::index_sequence<Js...>) {
+    return error_norm((_Zero() + ... + _scaled<(TAB.template e<Js>() != 0)>(TAB.template e<Js>() * dt, k(Js))),
+        x, y, atol, rtol);
+}
+
+// Attempt a step from x, leaving the candidate solution in the method
+// storage, and return the scaled norm of the error estimate.
+template <const auto& TAB, typename Y, typename X, typename SYSTEM>
+double try_step(EmbeddedRK<TAB, Y, false>& method,
+    SYSTEM&                                sys,
+    double                                 t,
+    double                                 dt,
+    const X&                               x,
+    double                                 atol,
+    double                                 rtol) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& y = method.storage[0];
+    auto  k = [&](std::size_t j) -> Y& { return method._k(j); };
+
+    // first stage, unless known from the previous attempt or step
+    if (!method._has_first) {
+        y = x;
+        sys(t, y, k(0));
+        method.nevals++;
+        method._has_first = true;
+    }
+
+    // other stages
+    _static_for<N - 1>([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value + 1;
+        _erk_stage<TAB, I>(y, x, dt, k, std::make_index_sequence<I>());
+        sys(t + TAB.template c<I>() * dt, y, k(I));
+        method.nevals++;
+    });
+
+    // for FSAL pairs, the last stage is the candidate solution already
+    if constexpr (!TAB.fsal())
+        _erk_solution<TAB>(y, x, dt, k, std::make_index_sequence<N>());
+
+    return _erk_error_norm<TAB>(x, y, dt, k, atol, rtol, std::make_index_sequence<N>());
+}
+
+// Accept the last attempted step. The stages are not stored during the
+// attempts, so they are formed again here if the stage cache needs them.
+template <const auto& TAB, typename Y, typename SYSTEM, typename X, typename STAGECACHE>
+void accept_step(EmbeddedRK<TAB, Y, false>& method,
+    SYSTEM&                                  sys,
+    double                                   t,
+    double                                   dt,
+    X&                                       x,
+    STAGECACHE&&                             c) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& y = method.storage[0];
+    auto  k = [&](std::size_t j) -> Y& { return method._k(j); };
+
+    c.setup_step(t, dt);
+    if constexpr (_stores_stages_v<STAGECACHE>) {
+        _static_for<N>([&](auto i) {
+            constexpr std::size_t I = decltype(i)::value;
+            _erk_stage<TAB, I>(y, x, dt, k, std::make_index_sequence<I>());
+            c.push_back(y);
+        });
+    }
+    c.close_step();
+
+    if constexpr (TAB.fsal()) {
+        x = y;
+        std::swap(method._first, method._last);
+    } else {
+        _erk_solution<TAB>(x, x, dt, k, std::make_index_sequence<N>());
+        method._has_first = false;
+    }
+}
+}
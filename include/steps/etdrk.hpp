@@ -0,0 +1,221 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "generic.hpp"
+#include <cstddef>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Exponential time differencing Runge-Kutta methods of Cox and Matthews,
+// for systems whose implicit term A is linear and stiff, e.g. diagonal in
+// the Fourier basis. The linear term is integrated exactly, and the
+// implicit term must provide the method
+//
+//      void phi(Z& out, const Z& in, double c, std::size_t k);
+//
+// returning out = phi_k(c*A) in, see phi.hpp, where PhiTable caches the
+// coefficients of diagonal operators. The stages pushed to the stage
+// cache are the initial state and the intermediate stages, and the
+// adjoint methods assume that A is self-adjoint.
+
+// Second order method, ETD2RK
+template <typename Y, bool ISADJOINT = false>
+struct ETDRK2 : public AbstractMethod<Y, 4, ISADJOINT> {
+    ETDRK2(const Y& x)
+        : AbstractMethod<Y, 4, ISADJOINT>(x) {}
+};
+
+// forward integration
+template <typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(ETDRK2<Y, false>& method,
+          SYSTEM&           sys,
+          double            t,
+          double            dt,
+          X&                x,
+          STAGECACHE&&      c) {
+
+    // aliases
+    auto& y  = method.storage[0];
+    auto& Nu = method.storage[1];
+    auto& Na = method.storage[2];
+    auto& w  = method.storage[3];
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    // a = phi_0 u + dt phi_1 N(u)
+    y = x;
+    c.push_back(y);
+    sys(t, y, Nu);
+    sys.phi(Na, y, dt, 0);
+    sys.phi(w, Nu, dt, 1);
+    y = Na + dt * w;
+
+    // u = a + dt phi_2 (N(a) - N(u))
+    c.push_back(y);
+    sys(t + dt, y, Na);
+    Na = Na - Nu;
+    sys.phi(w, Na, dt, 2);
+    x = y + dt * w;
+
+    c.close_step();
+}
+
+// backward integration
+template <typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(ETDRK2<Y, true>& method,
+          SYSTEM&          sys,
+          double           t,
+          double           dt,
+          X&               x,
+          STAGES&&         stages) {
+
+    // aliases
+    auto& p = method.storage[0];
+    auto& q = method.storage[1];
+    auto& r = method.storage[2];
+    auto& l = method.storage[3];
+
+    // adjoint of the second stage
+    l = x;
+    sys.phi(p, l, dt, 2);
+    q = dt * p;
+    sys(t + dt, stages[1], q, r);
+    l = l + r;
+
+    // adjoint of the first stage
+    sys.phi(q, l, dt, 1);
+    q = dt * q - dt * p;
+    sys(t, stages[0], q, r);
+    sys.phi(p, l, dt, 0);
+    x = p + r;
+}
+
+// Fourth order method, ETDRK4. The exponential over the full step is
+// obtained as the square of that over half the step, so that only phi_0
+// and phi_1 are needed at half the step, and phi_1 to phi_3 at the step.
+template <typename Y, bool ISADJOINT = false>
+struct ETDRK4 : public AbstractMethod<Y, 7, ISADJOINT> {
+    ETDRK4(const Y& x)
+        : AbstractMethod<Y, 7, ISADJOINT>(x) {}
+};
+
+// forward integration
+template <typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(ETDRK4<Y, false>& method,
+          SYSTEM&           sys,
+          double            t,
+          double            dt,
+          X&                x,
+          STAGECACHE&&      c) {
+
+    // aliases
+    auto& y  = method.storage[0];
+    auto& Nu = method.storage[1];
+    auto& Na = method.storage[2];
+    auto& Nb = method.storage[3];
+    auto& Nc = method.storage[4];
+    auto& Eu = method.storage[5];
+    auto& w  = method.storage[6];
+
+    const double h = 0.5 * dt;
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    // a = phi_0 u + h phi_1 N(u), at half the step
+    y = x;
+    c.push_back(y);
+    sys(t, y, Nu);
+    sys.phi(Eu, y, h, 0);
+    sys.phi(w, Nu, h, 1);
+    y = Eu + h * w;
+
+    // b = phi_0 u + h phi_1 N(a), at half the step, keeping phi_0 a in Nc
+    c.push_back(y);
+    sys(t + h, y, Na);
+    sys.phi(Nc, y, h, 0);
+    sys.phi(w, Na, h, 1);
+    y = Eu + h * w;
+
+    // c = phi_0 a + h phi_1 (2 N(b) - N(u)), at half the step
+    c.push_back(y);
+    sys(t + h, y, Nb);
+    y = 2.0 * Nb - Nu;
+    sys.phi(w, y, h, 1);
+    y = Nc + h * w;
+
+    // the solution is phi_0 u + dt phi_1 N(u)
+    //                          + dt phi_2 (-3 N(u) + 2 N(a) + 2 N(b) - N(c))
+    //                          + dt phi_3 (4 N(u) - 4 N(a) - 4 N(b) + 4 N(c))
+    c.push_back(y);
+    sys(t + dt, y, Nc);
+    sys.phi(y, Eu, h, 0);
+    sys.phi(w, Nu, dt, 1);
+    assign_all(y, y + dt * w, Eu, 2.0 * (Na + Nb) - 3.0 * Nu - Nc);
+    sys.phi(w, Eu, dt, 2);
+    assign_all(y, y + dt * w, Eu, 4.0 * (Nu - Na - Nb + Nc));
+    sys.phi(w, Eu, dt, 3);
+    x = y + dt * w;
+
+    c.close_step();
+}
+
+// backward integration
+template <typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(ETDRK4<Y, true>& method,
+          SYSTEM&          sys,
+          double           t,
+          double           dt,
+          X&               x,
+          STAGES&&         stages) {
+
+    // aliases
+    auto& l  = method.storage[0];
+    auto& lu = method.storage[1];
+    auto& p  = method.storage[2];
+    auto& q  = method.storage[3];
+    auto& nu = method.storage[4];
+    auto& nb = method.storage[5];
+    auto& la = method.storage[6];
+
+    const double h = 0.5 * dt;
+
+    // adjoints of the four nonlinear terms, where those of N(a) and N(b)
+    // are equal, and of the exponential over the full step
+    l = x;
+    sys.phi(lu, l, dt, 1);
+    sys.phi(p, l, dt, 2);
+    sys.phi(q, l, dt, 3);
+    assign_all(nu, dt * (lu - 3.0 * p + 4.0 * q),
+               nb, (2.0 * dt) * (p - 2.0 * q),
+               la, dt * (4.0 * q - p));
+    sys.phi(q, l, h, 0);
+    sys.phi(lu, q, h, 0);
+
+    // adjoint of the stage c
+    sys(t + dt, stages[3], la, p);
+    sys.phi(q, p, h, 1);
+    sys.phi(la, p, h, 0);
+    assign_all(p, nb + dt * q, nu, nu - h * q);
+
+    // adjoint of the stage b
+    sys(t + h, stages[2], p, q);
+    sys.phi(p, q, h, 0);
+    sys.phi(l, q, h, 1);
+    assign_all(lu, lu + p, nb, nb + h * l);
+
+    // adjoint of the stage a
+    sys(t + h, stages[1], nb, p);
+    la = la + p;
+    sys.phi(p, la, h, 0);
+    sys.phi(q, la, h, 1);
+    assign_all(lu, lu + p, nu, nu + h * q);
+
+    // adjoint of the initial state
+    sys(t, stages[0], nu, p);
+    x = lu + p;
+}
+}
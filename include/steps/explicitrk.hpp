@@ -0,0 +1,189 @@
+#pragma once
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "generic.hpp"
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Explicit Runge-Kutta methods defined by a Butcher tableau, e.g.
+//
+//      auto m = ExplicitRK<SSPRK3, Y>(x);
+//
+// where the tableau is a constexpr global, see tableaux.hpp. The forward
+// and adjoint steps are generated from the tableau at compile time, with
+// the stage loops unrolled and the terms with zero coefficients dropped.
+// In the forward step, the stage derivative k_j is kept from stage j to
+// its last use only, so that stages share registers when the tableau
+// allows it. The adjoint step needs all stages until the end. Stages
+// that do not contribute to the solution are not evaluated, but their
+// value is still pushed to the stage cache.
+
+// last stage using k_j, or N if k_j enters the update of the state
+template <std::size_t N>
+constexpr std::array<std::size_t, N> _erk_last_use(const Tableau<N>& tab) {
+    std::array<std::size_t, N> last = {};
+    for (std::size_t j = 0; j != N; j++) {
+        last[j] = j;
+        for (std::size_t i = j + 1; i != N; i++)
+            if (tab('a', i, j) != 0)
+                last[j] = i;
+        if (tab('b', j) != 0)
+            last[j] = N;
+    }
+    return last;
+}
+
+// whether k_j is used at all, e.g. the last stage of a FSAL pair is not
+template <std::size_t N>
+constexpr bool _erk_is_used(const Tableau<N>& tab, std::size_t j) {
+    return _erk_last_use(tab)[j] > j;
+}
+
+// Register holding k_j in the forward step. At stage i, the register
+// of a k_j last used at stage i can be reused for k_i, because the
+// stage value is formed before k_i is computed.
+template <std::size_t N>
+constexpr std::array<std::size_t, N> _erk_registers(const Tableau<N>& tab) {
+    auto                       last = _erk_last_use(tab);
+    std::array<std::size_t, N> reg  = {};
+    for (std::size_t i = 0; i != N; i++) {
+        for (std::size_t r = 0; r != N; r++) {
+            bool taken = false;
+            for (std::size_t j = 0; j != i; j++)
+                taken = taken || (reg[j] == r && last[j] > i);
+            if (!taken) {
+                reg[i] = r;
+                break;
+            }
+        }
+    }
+    return reg;
+}
+
+template <std::size_t N>
+constexpr std::size_t _erk_nregisters(const Tableau<N>& tab) {
+    auto        reg = _erk_registers(tab);
+    std::size_t n   = 0;
+    for (std::size_t j = 0; j != N; j++)
+        n = reg[j] + 1 > n ? reg[j] + 1 : n;
+    return n;
+}
+
+template <std::size_t N>
+constexpr bool _is_explicit(const Tableau<N>& tab) {
+    for (std::size_t i = 0; i != N; i++)
+        for (std::size_t j = i; j != N; j++)
+            if (tab('a', i, j) != 0)
+                return false;
+    return true;
+}
+
+// number of storage registers: the stage value plus the stage derivatives
+template <const auto& TAB, bool ISADJOINT>
+inline constexpr std::size_t _erk_storage_size
+    = 1 + (ISADJOINT ? std::decay_t<decltype(TAB)>::nstages : _erk_nregisters(TAB));
+
+template <const auto& TAB, typename Y, bool ISADJOINT = false>
+struct ExplicitRK : public AbstractMethod<Y, _erk_storage_size<TAB, ISADJOINT>, ISADJOINT> {
+    static_assert(_is_explicit(TAB), "the tableau must be explicit");
+
+    ExplicitRK(const Y& x)
+        : AbstractMethod<Y, _erk_storage_size<TAB, ISADJOINT>, ISADJOINT>(x) {}
+};
+
+// y = x + dt * sum_j a_ij k_j, for j < i
+template <const auto& TAB, std::size_t I, typename Y, typename X, typename K, std::size_t... Js>
+inline void _erk_stage(Y& y, const X& x, double dt, K&& k, std::index_sequence<Js...>) {
+    y = (x + ... + _scaled<(TAB.template a<I, Js>() != 0)>(TAB.template a<I, Js>() * dt, k(Js)));
+}
+
+// y = x + dt * sum_j b_j k_j
+template <const auto& TAB, typename Y, typename X, typename K, std::size_t... Js>
+inline void _erk_solution(Y& y, const X& x, double dt, K&& k, std::index_sequence<Js...>) {
+    y = (x + ... + _scaled<(TAB.template b<Js>() != 0)>(TAB.template b<Js>() * dt, k(Js)));
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(ExplicitRK<TAB, Y, false>& method,
+    SYSTEM&                          sys,
+    double                           t,
+    double                           dt,
+    X&                               x,
+    STAGECACHE&&                     c) {
+
+    constexpr std::size_t N   = std::decay_t<decltype(TAB)>::nstages;
+    constexpr auto        reg = _erk_registers(TAB);
+
+    // aliases
+    auto& y = method.storage[0];
+    auto  k = [&](std::size_t j) -> Y& { return method.storage[1 + reg[j]]; };
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    // stages
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value;
+        _erk_stage<TAB, I>(y, x, dt, k, std::make_index_sequence<I>());
+        if constexpr (_erk_is_used(TAB, I))
+            sys(t + TAB.template c<I>() * dt, y, k(I));
+        c.push_back(y);
+    });
+
+    // wrap up
+    _erk_solution<TAB>(x, x, dt, k, std::make_index_sequence<N>());
+
+    c.close_step();
+}
+
+// y = b_i x + dt * sum_j a_ji k_j, for j > i, over the stages that are used
+template <const auto& TAB, std::size_t I, typename Y, typename X, typename K, std::size_t... Js>
+inline void _erk_adjoint_stage(Y& y, const X& x, double dt, K&& k, std::index_sequence<Js...>) {
+    y = (_scaled<(TAB.template b<I>() != 0)>(TAB.template b<I>(), x) + ...
+        + _scaled<(TAB.template a<I + 1 + Js, I>() != 0 && _erk_is_used(TAB, I + 1 + Js))>(
+            TAB.template a<I + 1 + Js, I>() * dt, k(I + 1 + Js)));
+}
+
+// x = x + dt * sum_j k_j, over the stages that are used
+template <const auto& TAB, typename X, typename K, std::size_t... Js>
+inline void _erk_adjoint_update(X& x, double dt, K&& k, std::index_sequence<Js...>) {
+    x = (x + ... + _scaled<_erk_is_used(TAB, Js)>(dt, k(Js)));
+}
+
+// Backward integration. This is the discrete adjoint of the forward step,
+// where the adjoint of the stage value is b_i x + dt * sum_j a_ji k_j and
+// k_i is the adjoint operator, linearised about the i-th stage, applied to it.
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(ExplicitRK<TAB, Y, true>& method,
+    SYSTEM&                         sys,
+    double                          t,
+    double                          dt,
+    X&                              x,
+    STAGES&&                        stages) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& y = method.storage[0];
+    auto  k = [&](std::size_t j) -> Y& { return method.storage[1 + j]; };
+
+    // stages, in reverse order
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t I = N - 1 - decltype(i)::value;
+        if constexpr (_erk_is_used(TAB, I)) {
+            _erk_adjoint_stage<TAB, I>(y, x, dt, k, std::make_index_sequence<N - 1 - I>());
+            sys(t + TAB.template c<I>() * dt, stages[I], y, k(I));
+        }
+    });
+
+    // wrap up
+    _erk_adjoint_update<TAB>(x, dt, k, std::make_index_sequence<N>());
+}
+}
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace Flows {
@@ -15,11 +18,63 @@ struct AbstractMethod {
         : storage(N, x) {}
 };
 
-// trait used to determine whether we are integrating an adjoint problem
+// trait used to determine whether we are integrating an adjoint problem,
+// true for all methods derived from an adjoint AbstractMethod
+template <typename X, std::size_t N>
+std::true_type _is_adjoint_method(const AbstractMethod<X, N, true>*);
+
+std::false_type _is_adjoint_method(...);
+
 template <typename T>
-struct isAdjoint : std::false_type {};
+struct isAdjoint : decltype(_is_adjoint_method(std::declval<T*>())) {};
 
-template <typename X, std::size_t N>
-struct isAdjoint<AbstractMethod<X, N, true>> : std::true_type {};
+////////////////////////////////////////////////////////////////
+// Methods keeping a history between steps, e.g. multistep methods, are
+// restarted at the beginning of an integration: without arguments for the
+// forward integration, and with the number of entries of the stage cache
+// for the integration over the cache. Other methods are left untouched.
+template <typename METHOD, typename... ARGS>
+inline auto _restart(METHOD& method, int, ARGS... args) -> decltype(method.restart(args...)) {
+    return method.restart(args...);
+}
+
+template <typename METHOD, typename... ARGS>
+inline void _restart(METHOD&, long, ARGS...) {}
+
+// Methods whose steps depend on the previous steps, besides the state,
+// e.g. multistep methods or methods reusing a Jacobian, so that a step
+// cannot be made again on its own, e.g. for local recomputation
+template <typename METHOD>
+struct _has_history : std::false_type {};
+
+template <typename METHOD>
+inline constexpr bool _has_history_v = _has_history<std::decay_t<METHOD>>::value;
+
+// Adaptive methods attempting steps without a stage cache can keep the
+// stages of the attempts when the accepted steps are pushed to a stage
+// cache, so that the stages are not formed again on acceptance. Returns
+// the previous setting, false for methods that never record.
+template <typename METHOD>
+inline auto _record_stages(METHOD& method, int, bool on) -> decltype(method.record_stages(on)) {
+    return method.record_stages(on);
+}
+
+template <typename METHOD>
+inline bool _record_stages(METHOD&, long, bool) { return false; }
+
+////////////////////////////////////////////////////////////////
+// Unroll a loop over the stages of a method. The body is called with
+// std::integral_constant<std::size_t, k>() for k = 0, ..., N-1, so that
+// the stage index can be used as a template argument, e.g. to access
+// the coefficients of a constexpr tableau.
+template <typename F, std::size_t... Ks>
+inline void _static_for(F&& f, std::index_sequence<Ks...>) {
+    (f(std::integral_constant<std::size_t, Ks>()), ...);
+}
+
+template <std::size_t N, typename F>
+inline void _static_for(F&& f) {
+    _static_for(f, std::make_index_sequence<N>());
+}
 
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "generic.hpp"
+#include <cstddef>
+#include <type_traits>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Low storage explicit Runge-Kutta methods in the 2N form, e.g.
+//
+//      auto m = LowStorageRK<CarpenterKennedy4, Y>(x);
+//
+// see LowStorageTableau. The state is updated in place at every stage,
+// so the method only needs the increment dq and the stage derivative,
+// i.e. two registers, whatever the number of stages. The updates of dq
+// and of the state are made in a single pass. If the state is not of
+// the register type, e.g. a coupled reference, a third register holding
+// a copy of the state is allocated on first use. The adjoint method is
+// the discrete adjoint of the forward method, and needs two registers.
+template <const auto& TAB, typename Y, bool ISADJOINT = false>
+struct LowStorageRK : public AbstractMethod<Y, 2, ISADJOINT> {
+    static_assert(TAB.template A<0>() == 0, "the first stage must not use dq");
+
+    LowStorageRK(const Y& x)
+        : AbstractMethod<Y, 2, ISADJOINT>(x) {}
+};
+
+// stages of the forward step, updating q in place
+template <const auto& TAB, typename Q, typename Y, typename SYSTEM, typename STAGECACHE>
+inline void _lsrk_stages(SYSTEM& sys, double t, double dt, Q& q, Y& dq, Y& k, STAGECACHE& c) {
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t K = decltype(i)::value;
+        constexpr double      A = TAB.template A<K>();
+        constexpr double      B = TAB.template B<K>();
+
+        sys(t + TAB.template c<K>() * dt, q, k);
+        c.push_back(q);
+
+        // dq is not needed after the last stage
+        if constexpr (K + 1 < N) {
+            assign_all(dq, _scaled<(A != 0)>(A, dq) + dt * k,
+                q, q + _scaled<(A != 0)>(A * B, dq) + (B * dt) * k);
+        } else {
+            q = q + _scaled<(A != 0)>(A * B, dq) + (B * dt) * k;
+        }
+    });
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(LowStorageRK<TAB, Y, false>& method,
+    SYSTEM&                            sys,
+    double                             t,
+    double                             dt,
+    X&                                 x,
+    STAGECACHE&&                       c) {
+
+    // copy of the state, if it is not of the register type
+    if constexpr (!std::is_same_v<X, Y>)
+        if (method.storage.size() < 3)
+            method.storage.resize(3, method.storage[0]);
+
+    // aliases
+    auto& dq = method.storage[0];
+    auto& k  = method.storage[1];
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    if constexpr (std::is_same_v<X, Y>) {
+        _lsrk_stages<TAB>(sys, t, dt, x, dq, k, c);
+    } else {
+        auto& q = method.storage[2];
+        q       = x;
+        _lsrk_stages<TAB>(sys, t, dt, q, dq, k, c);
+        x = q;
+    }
+
+    c.close_step();
+}
+
+// Backward integration. The adjoint of dq, w, is B_k x + A_{k+1} w at the
+// k-th stage, and the adjoint operator, linearised about the k-th stage,
+// is applied to it. The updates of the state and of w are made in a single
+// pass, using the value of the state after the update.
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(LowStorageRK<TAB, Y, true>& method,
+    SYSTEM&                           sys,
+    double                            t,
+    double                            dt,
+    X&                                x,
+    STAGES&&                          stages) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& w = method.storage[0];
+    auto& k = method.storage[1];
+
+    w = TAB.template B<N - 1>() * x;
+
+    // stages, in reverse order
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t K = N - 1 - decltype(i)::value;
+
+        sys(t + TAB.template c<K>() * dt, stages[K], w, k);
+
+        if constexpr (K > 0) {
+            constexpr double A = TAB.template A<K>();
+            constexpr double B = TAB.template B<K - 1>();
+            assign_all(x, x + dt * k,
+                w, _scaled<(A != 0)>(A, w) + B * x + (B * dt) * k);
+        } else {
+            x = x + dt * k;
+        }
+    });
+}
+
+////////////////////////////////////////////////////////////////
+// Low storage explicit Runge-Kutta methods in the 2R form, e.g.
+//
+//      auto m = LowStorage2RRK<LowStorage2R5, Y>(x);
+//
+// see LowStorage2RTableau. The state is updated in place at every stage,
+// and the method only needs the next stage and the stage derivative, i.e.
+// two registers, whatever the number of stages. The updates of the next
+// stage and of the state are made in a single pass. As for LowStorageRK,
+// a third register holds a copy of the state if it is not of the register
+// type. The adjoint method is the discrete adjoint of the forward method,
+// and needs two registers.
+template <const auto& TAB, typename Y, bool ISADJOINT = false>
+struct LowStorage2RRK : public AbstractMethod<Y, 2, ISADJOINT> {
+    LowStorage2RRK(const Y& x)
+        : AbstractMethod<Y, 2, ISADJOINT>(x) {}
+};
+
+// stages of the forward step, updating q in place
+template <const auto& TAB, typename Q, typename Y, typename SYSTEM, typename STAGECACHE>
+inline void _ls2r_stages(SYSTEM& sys, double t, double dt, Q& q, Y& y, Y& k, STAGECACHE& c) {
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t K = decltype(i)::value;
+        constexpr double      a = TAB.template a<K>();
+        constexpr double      b = TAB.template b<K>();
+
+        // the first stage is the state
+        const auto& stage = _pick<K == 0>(q, y);
+        sys(t + TAB.template c<K>() * dt, stage, k);
+        c.push_back(stage);
+
+        // the next stage is not needed after the last stage
+        if constexpr (K + 1 < N) {
+            assign_all(y, q + _scaled<(a != 0)>(a * dt, k),
+                q, q + _scaled<(b != 0)>(b * dt, k));
+        } else {
+            q = q + _scaled<(b != 0)>(b * dt, k);
+        }
+    });
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(LowStorage2RRK<TAB, Y, false>& method,
+    SYSTEM&                              sys,
+    double                               t,
+    double                               dt,
+    X&                                   x,
+    STAGECACHE&&                         c) {
+
+    // copy of the state, if it is not of the register type
+    if constexpr (!std::is_same_v<X, Y>)
+        if (method.storage.size() < 3)
+            method.storage.resize(3, method.storage[0]);
+
+    // aliases
+    auto& y = method.storage[0];
+    auto& k = method.storage[1];
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    if constexpr (std::is_same_v<X, Y>) {
+        _ls2r_stages<TAB>(sys, t, dt, x, y, k, c);
+    } else {
+        auto& q = method.storage[2];
+        q       = x;
+        _ls2r_stages<TAB>(sys, t, dt, q, y, k, c);
+        x = q;
+    }
+
+    c.close_step();
+}
+
+// Backward integration. The adjoint of the k-th stage derivative is
+// b_k dt x + a_k dt w, with w the adjoint of the next stage, to which the
+// adjoint operator, linearised about the k-th stage, is applied to give
+// the adjoint of the k-th stage. The adjoint of the state gets w at every
+// stage, as each stage starts from the state, in the same pass.
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(LowStorage2RRK<TAB, Y, true>& method,
+    SYSTEM&                             sys,
+    double                              t,
+    double                              dt,
+    X&                                  x,
+    STAGES&&                            stages) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // aliases
+    auto& w = method.storage[0];
+    auto& k = method.storage[1];
+
+    // stages, in reverse order
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t K = N - 1 - decltype(i)::value;
+        constexpr double      a = TAB.template a<K>();
+        constexpr double      b = TAB.template b<K>();
+
+        if constexpr (K + 1 < N) {
+            assign_all(k, _scaled<(b != 0)>(b * dt, x) + _scaled<(a != 0)>(a * dt, w),
+                x, x + w);
+        } else {
+            k = (b * dt) * x;
+        }
+
+        sys(t + TAB.template c<K>() * dt, stages[K], k, w);
+
+        if constexpr (K == 0)
+            x = x + w;
+    });
+}
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "generic.hpp"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Multirate fourth order Runge-Kutta method for coupled systems, e.g.
+//
+//      auto m = MultirateRK4<Pair<A, B>>(x, { 1, 10 });
+//
+// where the k-th component is advanced with the given number of sub-steps
+// per step of the Flow, so that the right hand side of slow components is
+// evaluated at the macro step only. In a coupled System, the k-th function
+// depends on the components 0 to k only, so the components are advanced in
+// order over the macro step, each with the classical method on its own
+// sub-steps. The earlier components are then known over the whole macro
+// step, and are evaluated at the stage times of the later ones with the
+// cubic Hermite interpolant of their sub-steps, which is fourth order for
+// the state and third order for the time derivative. Only the explicit
+// term is used, as in RK4. The number of evaluations of the function of
+// each component in the last integration is recorded. The state at the
+// beginning of each macro step is pushed to the stage cache, and there is
+// no adjoint method.
+template <typename Y>
+struct MultirateRK4;
+
+template <typename... Ts>
+struct MultirateRK4<Coupled<Ts...>> : public AbstractMethod<Coupled<Ts...>, 6, false> {
+    static constexpr std::size_t N = sizeof...(Ts);
+
+    // sub-steps per macro step of each component
+    std::array<std::size_t, N> substeps;
+
+    // evaluations of the function of each component in the last integration
+    std::array<std::size_t, N> nevals;
+
+    // states and time derivatives at the sub-steps of each component
+    std::tuple<std::vector<Ts>...> _u;
+    std::tuple<std::vector<Ts>...> _f;
+
+    MultirateRK4(const Coupled<Ts...>& x, std::array<std::size_t, N> substeps)
+        : AbstractMethod<Coupled<Ts...>, 6, false>(x)
+        , substeps(substeps)
+        , nevals() {
+        for (auto m : substeps)
+            if (m == 0)
+                throw std::invalid_argument("the number of sub-steps must be positive");
+    }
+
+    // call at the beginning of an integration
+    void restart() { nevals.fill(0); }
+};
+
+// set the J-th component of z and dzdt at time t in [t0, t0 + dt], from the
+// Hermite interpolant of the sub-steps of the last macro step
+template <std::size_t J, typename METHOD, typename Z>
+inline void _mr_interpolate(METHOD& method, Z& z, Z& dzdt, double t0, double dt, double t) {
+    auto&             us = std::get<J>(method._u);
+    auto&             fs = std::get<J>(method._f);
+    const std::size_t m  = method.substeps[J];
+    const double      h  = dt / m;
+
+    double      s = (t - t0) / h;
+    std::size_t i = s <= 0 ? 0 : static_cast<std::size_t>(s);
+    if (i >= m)
+        i = m - 1;
+    const double th = s - i;
+
+    // basis functions and their derivatives
+    const double h00 = (2 * th - 3) * th * th + 1;
+    const double h10 = ((th - 2) * th + 1) * th * h;
+    const double h01 = (3 - 2 * th) * th * th;
+    const double h11 = (th - 1) * th * th * h;
+    const double d00 = (6 * th - 6) * th / h;
+    const double d10 = (3 * th - 4) * th + 1;
+    const double d01 = (6 - 6 * th) * th / h;
+    const double d11 = (3 * th - 2) * th;
+
+    auto u0 = refcouple(us[i]);
+    auto u1 = refcouple(us[i + 1]);
+    auto f0 = refcouple(fs[i]);
+    auto f1 = refcouple(fs[i + 1]);
+    refcouple(std::get<J>(z))    = h00 * u0 + h10 * f0 + h01 * u1 + h11 * f1;
+    refcouple(std::get<J>(dzdt)) = d00 * u0 + d10 * f0 + d01 * u1 + d11 * f1;
+}
+
+// evaluate the K-th function at time t, with the K-th component of z set
+template <std::size_t K, typename METHOD, typename SYSTEM, typename Z>
+inline void _mr_call(METHOD& method, SYSTEM& sys, Z& z, Z& dzdt, double t0, double dt, double t) {
+    _static_for<K>([&](auto j) {
+        _mr_interpolate<decltype(j)::value>(method, z, dzdt, t0, dt, t);
+    });
+    sys.template call<K>(t, z, dzdt);
+    method.nevals[K]++;
+}
+
+// forward integration
+template <typename... Ts, typename X, typename SYSTEM, typename STAGECACHE>
+void step(MultirateRK4<Coupled<Ts...>>& method,
+          SYSTEM&                       sys,
+          double                        t,
+          double                        dt,
+          X&                            x,
+          STAGECACHE&&                  c) {
+
+    constexpr std::size_t N = sizeof...(Ts);
+
+    // aliases
+    auto& z  = method.storage[0];
+    auto& dz = method.storage[1];
+    auto& k1 = method.storage[2];
+    auto& k2 = method.storage[3];
+    auto& k3 = method.storage[4];
+    auto& k4 = method.storage[5];
+
+    c.setup_step(t, dt);
+    c.push_back(x);
+    c.close_step();
+
+    _static_for<N>([&](auto k) {
+        constexpr std::size_t K = decltype(k)::value;
+        const std::size_t     m = method.substeps[K];
+        const double          h = dt / m;
+
+        // the K-th components, where the state is advanced in place
+        auto xk  = refcouple(std::get<K>(x));
+        auto zk  = refcouple(std::get<K>(z));
+        auto dzk = refcouple(std::get<K>(dz));
+        auto k1k = refcouple(std::get<K>(k1));
+        auto k2k = refcouple(std::get<K>(k2));
+        auto k3k = refcouple(std::get<K>(k3));
+        auto k4k = refcouple(std::get<K>(k4));
+
+        // the sub-steps are kept if later components need them
+        auto& us = std::get<K>(method._u);
+        auto& fs = std::get<K>(method._f);
+        if constexpr (K + 1 < N) {
+            us.resize(m + 1, std::get<K>(x));
+            fs.resize(m + 1, std::get<K>(x));
+            us[0] = std::get<K>(x);
+        }
+
+        for (std::size_t i = 0; i != m; i++) {
+            const double ti = t + i * h;
+
+            zk = xk;
+            _mr_call<K>(method, sys, z, dz, t, dt, ti);
+            k1k = dzk;
+
+            zk = xk + (0.5 * h) * k1k;
+            _mr_call<K>(method, sys, z, dz, t, dt, ti + 0.5 * h);
+            k2k = dzk;
+
+            zk = xk + (0.5 * h) * k2k;
+            _mr_call<K>(method, sys, z, dz, t, dt, ti + 0.5 * h);
+            k3k = dzk;
+
+            zk = xk + h * k3k;
+            _mr_call<K>(method, sys, z, dz, t, dt, ti + h);
+            k4k = dzk;
+
+            xk = xk + (h / 6) * k1k + (h / 3) * k2k + (h / 3) * k3k + (h / 6) * k4k;
+
+            if constexpr (K + 1 < N) {
+                fs[i]     = std::get<K>(k1);
+                us[i + 1] = std::get<K>(x);
+            }
+        }
+
+        // time derivative at the end of the macro step
+        if constexpr (K + 1 < N) {
+            zk = xk;
+            _mr_call<K>(method, sys, z, dz, t, dt, t + dt);
+            fs[m] = std::get<K>(dz);
+        }
+    });
+}
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "generic.hpp"
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// IMEX multistep methods, e.g.
+//
+//      auto m = IMEXMultistep<SBDF3, Y>(x);
+//
+// see MultistepTableau. Each step evaluates the explicit term once and
+// solves one implicit problem, reusing the states and explicit terms of
+// the previous steps, kept in the method storage. The first S-1 steps
+// after a restart are made with CNRK2, whose local error is small enough
+// for methods up to third order. The time step must be constant between
+// restarts, and Flow restarts the method at the beginning of each
+// integration.
+//
+// Each multistep step pushes the state to the stage cache, as a cache
+// entry of one stage. The startup steps push two entries, holding the
+// state and the predictor of CNRK2, so that the cache has one stage per
+// entry and the adjoint method does not need the forward explicit term.
+// The adjoint method is the discrete adjoint of the whole sequence of
+// steps, and the states and explicit terms of the previous steps become
+// adjoint variables pending for the entries still to be processed. It
+// must be restarted with the number of entries of the cache, which Flow
+// does, before stepping over them by hand.
+template <const auto& TAB, typename Y, bool ISADJOINT = false>
+struct IMEXMultistep;
+
+// S registers for the states, S for the explicit terms and three work
+// registers, or two for the pending adjoint variables of S - 1 steps and
+// five work registers
+template <const auto& TAB>
+inline constexpr std::size_t _ms_nregisters = 2 * std::decay_t<decltype(TAB)>::nsteps + 3;
+
+template <const auto& TAB, typename Y>
+struct IMEXMultistep<TAB, Y, false> : public AbstractMethod<Y, _ms_nregisters<TAB>, false> {
+    static constexpr std::size_t S = std::decay_t<decltype(TAB)>::nsteps;
+    static_assert(S >= 2 && S <= 3, "startup is accurate enough for two or three steps");
+
+    // steps since the last restart, and their time step
+    std::size_t _n;
+    double      _dt;
+
+    IMEXMultistep(const Y& x)
+        : AbstractMethod<Y, _ms_nregisters<TAB>, false>(x)
+        , _n(0)
+        , _dt(0) {}
+
+    // call at the beginning of an integration
+    void restart() { _n = 0; }
+
+    // state and explicit term at the m-th step
+    Y& _u(std::size_t m) { return this->storage[3 + m % S]; }
+    Y& _f(std::size_t m) { return this->storage[3 + S + m % S]; }
+};
+
+template <const auto& TAB, typename Y>
+struct _has_history<IMEXMultistep<TAB, Y, false>> : std::true_type {};
+
+template <const auto& TAB, typename Y>
+struct IMEXMultistep<TAB, Y, true> : public AbstractMethod<Y, _ms_nregisters<TAB>, true> {
+    static constexpr std::size_t S = std::decay_t<decltype(TAB)>::nsteps;
+    static_assert(S >= 2 && S <= 3, "startup is accurate enough for two or three steps");
+
+    // cache entries still to be processed
+    std::size_t _n;
+
+    IMEXMultistep(const Y& x)
+        : AbstractMethod<Y, _ms_nregisters<TAB>, true>(x)
+        , _n(0) {}
+
+    // call with the number of cache entries, before integrating over them
+    void restart(std::size_t nentries) {
+        _n = nentries;
+        for (std::size_t m = 0; m != S - 1; m++) {
+            _l(m) = _Zero();
+            _e(m) = _Zero();
+        }
+    }
+
+    // pending adjoint variables of the state and explicit term at the m-th step
+    Y& _l(std::size_t m) { return this->storage[5 + m % (S - 1)]; }
+    Y& _e(std::size_t m) { return this->storage[5 + (S - 1) + m % (S - 1)]; }
+};
+
+// right hand side sum_j alpha_j u_{n-j} + dt sum_j beta_j f_{n-j} + theta dt A u_n
+template <const auto& TAB, typename Y, typename U, typename F, typename AU, std::size_t... Js>
+inline void _ms_rhs(Y& w, double dt, U&& u, F&& f, const AU& Au, std::index_sequence<Js...>) {
+    constexpr double theta = TAB.theta();
+    w = (_Zero() + ... + (_scaled<(TAB.template alpha<Js>() != 0)>(TAB.template alpha<Js>(), u(Js))
+                            + _scaled<(TAB.template beta<Js>() != 0)>(TAB.template beta<Js>() * dt, f(Js))))
+      + _scaled<(theta != 0)>(theta * dt, Au);
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(IMEXMultistep<TAB, Y, false>& method,
+          SYSTEM&                       sys,
+          double                        t,
+          double                        dt,
+          X&                            x,
+          STAGECACHE&&                  c) {
+
+    constexpr std::size_t S = std::decay_t<decltype(TAB)>::nsteps;
+
+    // aliases
+    auto&       w0 = method.storage[0];
+    auto&       w1 = method.storage[1];
+    auto&       w2 = method.storage[2];
+    std::size_t n  = method._n;
+    auto&       u  = method._u(n);
+    auto&       f  = method._f(n);
+
+    if (n == 0) {
+        method._dt = dt;
+    } else if (std::fabs(dt - method._dt) > 1e-8 * std::fabs(method._dt)) {
+        throw std::invalid_argument("multistep methods need a constant time step");
+    }
+
+    u = x;
+    c.setup_step(t, dt);
+    c.push_back(u);
+    c.close_step();
+    sys(t, u, f);
+
+    if (n < S - 1) {
+        // startup, with the stages of CNRK2
+        sys.ImcA_mul(w0, u, -0.5 * dt);
+        w1 = w0 + dt * f;
+        sys.ImcA_div(w2, w1, 0.5 * dt);
+        c.setup_step(t, dt);
+        c.push_back(w2);
+        c.close_step();
+        sys(t + dt, w2, w1);
+        w2 = w0 + (0.5 * dt) * (f + w1);
+        sys.ImcA_div(x, w2, 0.5 * dt);
+    } else {
+        if constexpr (TAB.theta() != 0)
+            sys.mul(w0, u);
+        _ms_rhs<TAB>(w1, dt,
+            [&](std::size_t j) -> Y& { return method._u(n - j); },
+            [&](std::size_t j) -> Y& { return method._f(n - j); },
+            w0, std::make_index_sequence<S>());
+        sys.ImcA_div(x, w1, TAB.gamma() * dt);
+    }
+
+    method._n++;
+}
+
+// Backward integration over one cache entry. The adjoint of the explicit
+// term of the startup steps is formed in two halves, over the entries of
+// the predictor and of the state.
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGES>
+void step(IMEXMultistep<TAB, Y, true>& method,
+          SYSTEM&                      sys,
+          double                       t,
+          double                       dt,
+          X&                           x,
+          STAGES&&                     stages) {
+
+    constexpr std::size_t S = std::decay_t<decltype(TAB)>::nsteps;
+
+    if (method._n == 0)
+        throw std::runtime_error("restart the method with the number of cache entries");
+
+    // aliases
+    auto&             k1  = method.storage[0];
+    auto&             k2  = method.storage[1];
+    auto&             k3  = method.storage[2];
+    auto&             k4  = method.storage[3];
+    auto&             k5  = method.storage[4];
+    const std::size_t idx = --method._n;
+
+    if (idx >= 2 * (S - 1)) {
+        // multistep step, where mu = (I - gamma dt A)^{-1} x
+        const std::size_t n = idx - (S - 1);
+        auto&             l = method._l(n);
+        auto&             e = method._e(n);
+
+        sys.ImcA_div(k1, x, TAB.gamma() * dt);
+        if constexpr (TAB.theta() != 0)
+            sys.mul(k2, k1);
+        k3 = (TAB.template beta<0>() * dt) * k1 + e;
+        sys(t, stages[0], k3, k4);
+
+        // steps between the next and the oldest one
+        _static_for<S - 2>([&](auto j) {
+            constexpr std::size_t J  = decltype(j)::value + 1;
+            constexpr double      aJ = TAB.template alpha<J>();
+            assign_all(method._l(n - J), method._l(n - J) + _scaled<(aJ != 0)>(aJ, k1),
+                       method._e(n - J), method._e(n - J) + (TAB.template beta<J>() * dt) * k1);
+        });
+
+        // the registers of this step become those of the oldest one
+        constexpr double a0 = TAB.template alpha<0>();
+        constexpr double aS = TAB.template alpha<S - 1>();
+        constexpr double th = TAB.theta();
+        assign_all(x, _scaled<(a0 != 0)>(a0, k1) + _scaled<(th != 0)>(th * dt, k2) + k4 + l,
+                   l, _scaled<(aS != 0)>(aS, k1),
+                   e, (TAB.template beta<S - 1>() * dt) * k1);
+
+    } else if (idx % 2 == 1) {
+        // predictor of a startup step
+        sys.ImcA_div(k1, x, 0.5 * dt);
+        sys(t + dt, stages[0], k1, k2);
+        k3 = (0.5 * dt) * k2;
+        sys.ImcA_div(k4, k3, 0.5 * dt);
+
+    } else {
+        // state of a startup step
+        const std::size_t n = idx / 2;
+        k3 = (0.5 * dt) * k1 + dt * k4 + method._e(n);
+        sys(t, stages[0], k3, k5);
+        k3 = k1 + k4;
+        sys.ImcA_mul(k2, k3, -0.5 * dt);
+        x = k2 + k5 + method._l(n);
+    }
+}
+}
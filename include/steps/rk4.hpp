@@ -33,22 +33,26 @@ void step(RK4<Y, false>& method,
     // prepare cache for new step
     c.setup_step(t, dt);
 
-    // stages
-    y = x;
-    sys(t, y, k1);
-    c.push_back(y);
-
-    y = x + dt * k1 / 2;
-    sys(t + dt / 2, y, k2);
-    c.push_back(y);
-
-    y = x + dt * k2 / 2;
-    sys(t + dt / 2, y, k3);
-    c.push_back(y);
-
-    y = x + dt * k3;
-    sys(t + dt, y, k4);
-    c.push_back(y);
+    // stages, written into the slots of the cache if it has them
+    auto& y1 = _stage_slot(c, y, 0);
+    y1       = x;
+    _push_stage(c, y1, y);
+    sys(t, y1, k1);
+
+    auto& y2 = _stage_slot(c, y, 0);
+    y2       = x + dt * k1 / 2;
+    _push_stage(c, y2, y);
+    sys(t + dt / 2, y2, k2);
+
+    auto& y3 = _stage_slot(c, y, 0);
+    y3       = x + dt * k2 / 2;
+    _push_stage(c, y3, y);
+    sys(t + dt / 2, y3, k3);
+
+    auto& y4 = _stage_slot(c, y, 0);
+    y4       = x + dt * k3;
+    _push_stage(c, y4, y);
+    sys(t + dt, y4, k4);
 
     // wrap up
     x = x + dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
@@ -0,0 +1,125 @@
+#pragma once
+#include "../coupled.hpp"
+#include "../jacobian.hpp"
+#include "../stagecache.hpp"
+#include "../system.hpp"
+#include "../tableaux.hpp"
+#include "generic.hpp"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// Rosenbrock-W methods, for systems whose explicit term is stiff, e.g.
+//
+//      auto m = RosenbrockW<ROS34PW2, Y>(x);
+//
+// see RosenbrockTableau. The right hand side is the sum of the explicit
+// and of the implicit term, and each stage solves one linear problem with
+// an approximation J of its Jacobian, which should include the implicit
+// term if it is stiff, with the explicit term providing
+//
+//      void jacobian(double t, const Z& z);
+//      void ImcJ_div(Z& out, const Z& in, double c);
+//
+// where the first builds J at (t, z), e.g. storing a matrix or the point
+// of a Jacobian-vector product, and the second solves (I - c J) out = in,
+// e.g. with a factorisation that is kept as long as J and c do not change.
+// W methods keep their order for any J, so J is reused across steps
+// according to the JacobianReuse policy the method derives from. The
+// explicit term is assumed autonomous, as the methods do not include its
+// time derivative. The stages are pushed to the stage cache, but there is
+// no adjoint method, as a Jacobian rebuilt along the trajectory makes the
+// discrete adjoint depend on second derivatives of the explicit term.
+template <const auto& TAB, typename Y>
+struct RosenbrockW
+    : public AbstractMethod<Y, std::decay_t<decltype(TAB)>::nstages + 2, false>
+    , public JacobianReuse {
+
+    static constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    RosenbrockW(const Y& x)
+        : AbstractMethod<Y, N + 2, false>(x) {}
+};
+
+template <const auto& TAB, typename Y>
+struct _has_history<RosenbrockW<TAB, Y>> : std::true_type {};
+
+// y = x + sum_j a_ij U_j, for j < i
+template <const auto& TAB, std::size_t I, typename Y, typename X, typename U, std::size_t... Js>
+inline void _ros_stage(Y& y, const X& x, U&& u, std::index_sequence<Js...>) {
+    y = (x + ... + _scaled<(TAB.template a<I, Js>() != 0)>(TAB.template a<I, Js>(), u(Js)));
+}
+
+// f = dt * (f + Ay) + sum_j c_ij U_j, for j < i
+template <const auto& TAB, std::size_t I, typename Y, typename U, std::size_t... Js>
+inline void _ros_rhs(Y& f, const Y& Ay, double dt, U&& u, std::index_sequence<Js...>) {
+    f = ((dt * (f + Ay)) + ... + _scaled<(TAB.template c<I, Js>() != 0)>(TAB.template c<I, Js>(), u(Js)));
+}
+
+// x = x + sum_j m_j U_j
+template <const auto& TAB, typename X, typename U, std::size_t... Js>
+inline void _ros_solution(X& x, U&& u, std::index_sequence<Js...>) {
+    x = (x + ... + _scaled<(TAB.template m<Js>() != 0)>(TAB.template m<Js>(), u(Js)));
+}
+
+// forward integration
+template <const auto& TAB, typename Y, typename X, typename SYSTEM, typename STAGECACHE>
+void step(RosenbrockW<TAB, Y>& method,
+          SYSTEM&              sys,
+          double               t,
+          double               dt,
+          X&                   x,
+          STAGECACHE&&         c) {
+
+    constexpr std::size_t N = std::decay_t<decltype(TAB)>::nstages;
+
+    // state at the last build of the Jacobian, if its change is checked
+    if (method._check_state() && method.storage.size() < N + 3)
+        method.storage.resize(N + 3, method.storage[0]);
+
+    // aliases
+    auto& y = method.storage[0];
+    auto& f = method.storage[1];
+    auto  u = [&](std::size_t j) -> Y& { return method.storage[2 + j]; };
+
+    // first stage value, where the Jacobian is built if stale
+    y = x;
+    if (!method._has_jacobian
+        || method._age >= method.max_age
+        || (method._check_state()
+            && error_norm(y - method.storage[N + 2], y, method.storage[N + 2],
+                   method.atol, method.rtol) > 1)) {
+        sys.jacobian(t, y);
+        if (method._check_state())
+            method.storage[N + 2] = y;
+        method._has_jacobian = true;
+        method._age          = 0;
+        method.njacobians++;
+    }
+
+    // prepare cache for new step
+    c.setup_step(t, dt);
+
+    // stages, using U_i to hold A y before solving for it
+    _static_for<N>([&](auto i) {
+        constexpr std::size_t I = decltype(i)::value;
+        if constexpr (I > 0)
+            _ros_stage<TAB, I>(y, x, u, std::make_index_sequence<I>());
+        c.push_back(y);
+        sys(t + TAB.template alpha<I>() * dt, y, f);
+        sys.mul(u(I), y);
+        _ros_rhs<TAB, I>(f, u(I), dt, u, std::make_index_sequence<I>());
+        sys.ImcJ_div(u(I), f, TAB.gamma() * dt);
+    });
+
+    // wrap up
+    _ros_solution<TAB>(x, u, std::make_index_sequence<N>());
+    c.close_step();
+
+    method._age++;
+    method.nsolves += N;
+}
+}
@@ -1,41 +1,139 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <valarray>
 #include <vector>
 
-// use filesystem
-// namespace fs = std::filesystem;
+#include "coupled.hpp"
 
 namespace Flows {
 
-// ////////////////////////////////////////////////////////////////
-// // Disk STORAGE
-// template <typename Y>
-// class DiskStorage {
-// private:
-//     std::filesystem::path _casedir;
-
-// public:
-//     DiskStorage(std::filesystem::path casedir)
-//         : _casedir(casedir) {
-//             if (!fs::exists(_casedir))
-//                 throw std::invalid_argument("invalid directory");
-//         }
-
-//     template <typename X>
-//     void push_back(double t, X&& x) {
-//         // construct filename 
-//         std::string filename(16, '0');
-//         sprintf(&filename[0], "%14.8f", t);
-
-//         // construct full name
-//         std::filesystem::path fullname = _casedir / path(filename);
-
-//         // objects of type x should obey this interface
-//         write(fullname, x);
-//     }
-// };
+////////////////////////////////////////////////////////////////
+// BINARY FORMAT. Objects are written as raw bytes in the native byte
+// order, with the number of elements of containers before their data, so
+// files are meant to be read back on the same machine, e.g. for spilled
+// checkpoints. Other types are supported by overloading write_binary and
+// read_binary in their namespace.
+template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+inline void write_binary(std::ostream& out, const T& x) {
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+inline void read_binary(std::istream& in, T& x) {
+    in.read(reinterpret_cast<char*>(&x), sizeof(T));
+}
+
+// containers of arithmetic types, resized when read if needed
+template <typename T>
+inline void write_binary(std::ostream& out, const std::valarray<T>& x) {
+    static_assert(std::is_arithmetic_v<T>, "invalid element type");
+    write_binary(out, std::uint64_t(x.size()));
+    if (x.size() > 0)
+        out.write(reinterpret_cast<const char*>(&x[0]), x.size() * sizeof(T));
+}
+
+template <typename T>
+inline void read_binary(std::istream& in, std::valarray<T>& x) {
+    static_assert(std::is_arithmetic_v<T>, "invalid element type");
+    std::uint64_t size = 0;
+    read_binary(in, size);
+    if (x.size() != size)
+        x.resize(size);
+    if (size > 0)
+        in.read(reinterpret_cast<char*>(&x[0]), size * sizeof(T));
+}
+
+template <typename T>
+inline void write_binary(std::ostream& out, const std::vector<T>& x) {
+    static_assert(std::is_arithmetic_v<T>, "invalid element type");
+    write_binary(out, std::uint64_t(x.size()));
+    out.write(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(T));
+}
+
+template <typename T>
+inline void read_binary(std::istream& in, std::vector<T>& x) {
+    static_assert(std::is_arithmetic_v<T>, "invalid element type");
+    std::uint64_t size = 0;
+    read_binary(in, size);
+    x.resize(size);
+    in.read(reinterpret_cast<char*>(x.data()), size * sizeof(T));
+}
+
+// coupled objects, one component after the other
+template <typename... Ts>
+inline void write_binary(std::ostream& out, const Coupled<Ts...>& x) {
+    std::apply([&](const auto&... xs) { (write_binary(out, xs), ...); }, x._elems);
+}
+
+template <typename... Ts>
+inline void read_binary(std::istream& in, Coupled<Ts...>& x) {
+    std::apply([&](auto&... xs) { (read_binary(in, xs), ...); }, x._elems);
+}
+
+// write x to a file, replacing its content
+template <typename X>
+inline void write_binary(const std::filesystem::path& filename, const X& x) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    write_binary(out, x);
+    if (!out)
+        throw std::runtime_error("could not write " + filename.string());
+}
+
+// read x from a file written by the above
+template <typename X>
+inline void read_binary(const std::filesystem::path& filename, X& x) {
+    std::ifstream in(filename, std::ios::binary);
+    read_binary(in, x);
+    if (!in)
+        throw std::runtime_error("could not read " + filename.string());
+}
+
+////////////////////////////////////////////////////////////////
+// DISK STORAGE. Samples are written to a file each, in an existing
+// directory, and only their times are kept in memory. Samples are read
+// back one at a time with 'load'.
+template <typename Y>
+class DiskStorage {
+private:
+    std::filesystem::path _casedir;
+    std::vector<double>   _ts;
+
+public:
+    DiskStorage(std::filesystem::path casedir)
+        : _casedir(casedir) {
+        if (!std::filesystem::is_directory(_casedir))
+            throw std::invalid_argument("invalid directory");
+    }
+
+    template <typename X>
+    void push_back(double t, X&& x) {
+        write_binary(filename(_ts.size()), x);
+        _ts.push_back(t);
+    }
+
+    // name of the file of the i-th sample
+    std::filesystem::path filename(std::size_t i) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "sample_%08zu.bin", i);
+        return _casedir / name;
+    }
+
+    // read the i-th sample into y
+    void load(std::size_t i, Y& y) const {
+        read_binary(filename(i), y);
+    }
+
+    auto& times() { return _ts; }
+};
 
 ////////////////////////////////////////////////////////////////
 // RAM STORAGE
@@ -55,4 +153,4 @@ public:
     auto& times() { return _ts; }
     auto& samples() { return _xs; }
 };
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include <cstddef>
 #include <tuple>
+#include <utility>
+
+#include "coupled.hpp"
 
 namespace Flows {
 
@@ -19,6 +22,15 @@ struct NoOpFunction {
 
     template <typename Z, typename C>
     void ImcA_div(Z& dzdt, const Z& z, const C c) { dzdt = z; }
+
+    // phi_k(0) = 1/k!
+    template <typename Z, typename C>
+    void phi(Z& dzdt, const Z& z, const C c, std::size_t k) {
+        double f = 1;
+        for (std::size_t j = 2; j <= k; j++)
+            f *= j;
+        dzdt = (1.0 / f) * z;
+    }
 };
 
 ////////////////////////////////////////////////////////////////
@@ -63,21 +75,38 @@ public:
         _exTerm(t, x, z, dzdt);
     }
 
-    // call with a pair, but check we actually have two functions
-    template <typename ZA, typename ZB>
-    void operator()(double t, const Pair<ZA, ZB>& z, Pair<ZA, ZB>& dzdt) {
-        static_assert(N == 2, "invalid number of inputs");
-        std::get<0>(_exTerm)(t, std::get<0>(z), std::get<0>(dzdt));
-        std::get<1>(_exTerm)(t, std::get<0>(z), std::get<0>(dzdt), std::get<1>(z), std::get<1>(dzdt));
+    // call with a coupled object, but check we have as many functions as components.
+    // The k-th function receives the state and time derivative of components 0 to k.
+    template <typename... Zs>
+    inline void operator()(double t, const Coupled<Zs...>& z, Coupled<Zs...>& dzdt) {
+        static_assert(N == sizeof...(Zs), "invalid number of inputs");
+        _call_exTerms(t, z, dzdt, std::index_sequence_for<Zs...>());
     }
 
-    // call with a triplet, but check we actually have three functions
-    template <typename ZA, typename ZB, typename ZC>
-    void operator()(double t, const Triplet<ZA, ZB, ZC>& z, Triplet<ZA, ZB, ZC>& dzdt) {
-        static_assert(N == 3, "invalid number of inputs");
-        std::get<0>(_exTerm)(t, std::get<0>(z), std::get<0>(dzdt));
-        std::get<1>(_exTerm)(t, std::get<0>(z), std::get<0>(dzdt), std::get<1>(z), std::get<1>(dzdt));
-        std::get<2>(_exTerm)(t, std::get<0>(z), std::get<0>(dzdt), std::get<1>(z), std::get<1>(dzdt), std::get<2>(z), std::get<2>(dzdt));
+    // call the K-th function only, which sets the K-th component of dzdt
+    // given the components 0 to K of z and the components 0 to K-1 of dzdt,
+    // e.g. for methods advancing the components with different steps
+    template <std::size_t K, typename... Zs>
+    inline void call(double t, const Coupled<Zs...>& z, Coupled<Zs...>& dzdt) {
+        static_assert(N == sizeof...(Zs), "invalid number of inputs");
+        static_assert(K < N, "invalid component index");
+        _call_exTerm<K>(t, z, dzdt, std::make_index_sequence<K + 1>());
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // JACOBIAN OF THE EXPLICIT TERM, for linearly implicit methods, see
+    // steps/rosenbrock.hpp. Build an approximation J of the Jacobian at (t, z)
+    template <typename Z>
+    inline void jacobian(double t, const Z& z) {
+        static_assert(N == 1, "invalid number of inputs");
+        _exTerm.jacobian(t, z);
+    }
+
+    // return dzdt that solves (I - c*J) dzdt = z, with the last approximation J
+    template <typename Z, typename C>
+    inline void ImcJ_div(Z& dzdt, const Z& z, C c) {
+        static_assert(N == 1, "invalid number of inputs");
+        _exTerm.ImcJ_div(dzdt, z, c);
     }
 
     ////////////////////////////////////////////////////////////////
@@ -87,17 +116,9 @@ public:
         _imTerm.mul(dzdt, z);
     }
 
-    template <typename ZA, typename ZB>
-    inline void mul(Pair<ZA, ZB>& dzdt, const Pair<ZA, ZB>& z) {
-        std::get<0>(_imTerm).mul(std::get<0>(dzdt), std::get<0>(z));
-        std::get<1>(_imTerm).mul(std::get<1>(dzdt), std::get<1>(z));
-    }
-
-    template <typename ZA, typename ZB, typename ZC>
-    inline void mul(Triplet<ZA, ZB, ZC>& dzdt, const Triplet<ZA, ZB, ZC>& z) {
-        std::get<0>(_imTerm).mul(std::get<0>(dzdt), std::get<0>(z));
-        std::get<1>(_imTerm).mul(std::get<1>(dzdt), std::get<1>(z));
-        std::get<2>(_imTerm).mul(std::get<2>(dzdt), std::get<2>(z));
+    template <typename... Zs>
+    inline void mul(Coupled<Zs...>& dzdt, const Coupled<Zs...>& z) {
+        _mul(dzdt, z, std::index_sequence_for<Zs...>());
     }
 
     ////////////////////////////////////////////////////////////////
@@ -108,23 +129,64 @@ public:
         _imTerm.ImcA_##_xxx(dzdt, z, c);                                                    \
     }                                                                                       \
                                                                                             \
-    template <typename ZA, typename ZB, typename C>                                         \
-    inline void ImcA_##_xxx(Pair<ZA, ZB>& dzdt, const Pair<ZA, ZB>& z, C c) {               \
-        std::get<0>(_imTerm).ImcA_##_xxx(std::get<0>(dzdt), std::get<0>(z), c);             \
-        std::get<1>(_imTerm).ImcA_##_xxx(std::get<1>(dzdt), std::get<1>(z), c);             \
-    }                                                                                       \
-                                                                                            \
-    template <typename ZA, typename ZB, typename ZC, typename C>                            \
-    inline void ImcA_##_xxx(Triplet<ZA, ZB, ZC>& dzdt, const Triplet<ZA, ZB, ZC>& z, C c) { \
-        std::get<0>(_imTerm).ImcA_##_xxx(std::get<0>(dzdt), std::get<0>(z), c);             \
-        std::get<1>(_imTerm).ImcA_##_xxx(std::get<1>(dzdt), std::get<1>(z), c);             \
-        std::get<2>(_imTerm).ImcA_##_xxx(std::get<2>(dzdt), std::get<2>(z), c);             \
+    template <typename... Zs, typename C>                                                   \
+    inline void ImcA_##_xxx(Coupled<Zs...>& dzdt, const Coupled<Zs...>& z, C c) {           \
+        _ImcA_##_xxx(dzdt, z, c, std::index_sequence_for<Zs...>());                         \
     }
 
     _DEFINE_ImcA_xxx(div)
         _DEFINE_ImcA_xxx(mul)
 
 #undef _DEFINE_ImcA_xxx
+
+    ////////////////////////////////////////////////////////////////
+    // EXPONENTIAL INTEGRATORS: return dzdt = phi_k(c*A) z, see phi.hpp
+    template <typename Z, typename C>
+    inline void phi(Z& dzdt, const Z& z, C c, std::size_t k) {
+        _imTerm.phi(dzdt, z, c, k);
+    }
+
+    template <typename... Zs, typename C>
+    inline void phi(Coupled<Zs...>& dzdt, const Coupled<Zs...>& z, C c, std::size_t k) {
+        _phi(dzdt, z, c, k, std::index_sequence_for<Zs...>());
+    }
+
+private:
+    ////////////////////////////////////////////////////////////////
+    // HELPERS FOR COUPLED OBJECTS
+    template <typename Z, std::size_t... Ks>
+    inline void _call_exTerms(double t, const Z& z, Z& dzdt, std::index_sequence<Ks...>) {
+        (_call_exTerm<Ks>(t, z, dzdt, std::make_index_sequence<Ks + 1>()), ...);
+    }
+
+    // call the K-th function with arguments (t, z_0, dzdt_0, ..., z_K, dzdt_K)
+    template <std::size_t K, typename Z, std::size_t... Is>
+    inline void _call_exTerm(double t, const Z& z, Z& dzdt, std::index_sequence<Is...>) {
+        std::apply(std::get<K>(_exTerm),
+            std::tuple_cat(std::forward_as_tuple(t),
+                std::forward_as_tuple(std::get<Is>(z), std::get<Is>(dzdt))...));
+    }
+
+    template <typename Z, std::size_t... Is>
+    inline void _mul(Z& dzdt, const Z& z, std::index_sequence<Is...>) {
+        (std::get<Is>(_imTerm).mul(std::get<Is>(dzdt), std::get<Is>(z)), ...);
+    }
+
+#define _DEFINE_ImcA_xxx(_xxx)                                                              \
+    template <typename Z, typename C, std::size_t... Is>                                    \
+    inline void _ImcA_##_xxx(Z& dzdt, const Z& z, C c, std::index_sequence<Is...>) {        \
+        (std::get<Is>(_imTerm).ImcA_##_xxx(std::get<Is>(dzdt), std::get<Is>(z), c), ...);   \
+    }
+
+    _DEFINE_ImcA_xxx(div)
+        _DEFINE_ImcA_xxx(mul)
+
+#undef _DEFINE_ImcA_xxx
+
+    template <typename Z, typename C, std::size_t... Is>
+    inline void _phi(Z& dzdt, const Z& z, C c, std::size_t k, std::index_sequence<Is...>) {
+        (std::get<Is>(_imTerm).phi(std::get<Is>(dzdt), std::get<Is>(z), c, k), ...);
+    }
 };
 
 ////////////////////////////////////////////////////////////////
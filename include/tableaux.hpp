@@ -1,51 +1,344 @@
 #pragma once
 #include <array>
+#include <cstddef>
 #include <stdexcept>
 
 namespace Flows {
 
+////////////////////////////////////////////////////////////////
+// Tableaux are literal types, so that they can be defined as constexpr
+// global variables. The coefficients can be accessed at compile time
+// with the template accessors, e.g. tab.a<j, k>(), which lets methods
+// unroll their stage loops and drop terms with zero coefficients. The
+// accessors taking char arguments are kept for use at run time.
 template <size_t N>
 class Tableau{
 private:
-    std::array<std::array<double, N>, N> a;
-               std::array<double, N>     b;
-               std::array<double, N>     c;
+    std::array<std::array<double, N>, N> _a;
+               std::array<double, N>     _b;
+               std::array<double, N>     _c;
 public:
-    Tableau(std::array<std::array<double, N>, N> a,
-                       std::array<double, N>     b,
-                       std::array<double, N>     c)
-        : a (a) , b (b) , c (c) {}
+    // number of stages
+    static constexpr size_t nstages = N;
+
+    constexpr Tableau(std::array<std::array<double, N>, N> a,
+                                 std::array<double, N>     b,
+                                 std::array<double, N>     c)
+        : _a (a) , _b (b) , _c (c) {}
+
+    template <size_t J, size_t K>
+    constexpr double a() const {
+        static_assert(J < N && K < N, "invalid stage index");
+        return _a[J][K];
+    }
+
+    template <size_t K>
+    constexpr double b() const {
+        static_assert(K < N, "invalid stage index");
+        return _b[K];
+    }
+
+    template <size_t K>
+    constexpr double c() const {
+        static_assert(K < N, "invalid stage index");
+        return _c[K];
+    }
 
-    inline double operator () (char abc, int j, int k) const {
-        return a[j][k];
+    constexpr double operator () (char abc, int j, int k) const {
+        return _a[j][k];
     }
 
-    inline double operator () (char bc, int k) const {
+    constexpr double operator () (char bc, int k) const {
         switch (bc) {
-            case 'b': return b[k];
-            case 'c': return c[k];
+            case 'b': return _b[k];
+            case 'c': return _c[k];
         }
         throw std::invalid_argument("You must be joking!");
     }
 };
 
+////////////////////////////////////////////////////////////////
+// Tableau of an embedded pair. The weights bhat define a solution of
+// lower order, used to estimate the local error of the step, and the
+// error weights are e = b - bhat. The pair has the First Same As Last
+// property when the last stage is evaluated at the new solution, so
+// that it can be reused as the first stage of the next step.
+template <size_t N>
+class EmbeddedTableau : public Tableau<N> {
+private:
+    std::array<double, N> _bhat;
+
+public:
+    // order of the solution and of the embedded solution
+    size_t order;
+    size_t embedded_order;
+
+    constexpr EmbeddedTableau(std::array<std::array<double, N>, N> a,
+                                         std::array<double, N>     b,
+                                         std::array<double, N>     bhat,
+                                         std::array<double, N>     c,
+                              size_t order,
+                              size_t embedded_order)
+        : Tableau<N> (a, b, c)
+        , _bhat (bhat)
+        , order (order)
+        , embedded_order (embedded_order) {}
+
+    template <size_t K>
+    constexpr double bhat() const {
+        static_assert(K < N, "invalid stage index");
+        return _bhat[K];
+    }
+
+    template <size_t K>
+    constexpr double e() const {
+        return this->template b<K>() - bhat<K>();
+    }
+
+    constexpr bool fsal() const {
+        for (size_t k = 0; k != N; k++)
+            if ((*this)('a', N - 1, k) != (*this)('b', k))
+                return false;
+        return (*this)('c', N - 1) == 1;
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Tableau of a low storage method in the 2N form of Williamson, where
+// the stages make the updates
+//
+//      dq = A_k dq + dt f(t + c_k dt, q)
+//       q = q + B_k dq
+//
+// with A_0 = 0, so that only dq is kept between stages.
+template <size_t N>
+class LowStorageTableau{
+private:
+    std::array<double, N> _A;
+    std::array<double, N> _B;
+    std::array<double, N> _c;
+public:
+    // number of stages
+    static constexpr size_t nstages = N;
+
+    constexpr LowStorageTableau(std::array<double, N> A,
+                                std::array<double, N> B,
+                                std::array<double, N> c)
+        : _A (A) , _B (B) , _c (c) {}
+
+    template <size_t K>
+    constexpr double A() const {
+        static_assert(K < N, "invalid stage index");
+        return _A[K];
+    }
+
+    template <size_t K>
+    constexpr double B() const {
+        static_assert(K < N, "invalid stage index");
+        return _B[K];
+    }
+
+    template <size_t K>
+    constexpr double c() const {
+        static_assert(K < N, "invalid stage index");
+        return _c[K];
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Tableau of a low storage method in the 2R form of van der Houwen, see
+// Kennedy, Carpenter and Lewis (2000), where the Butcher matrix has
+// a_ij = b_j for j < i - 1, so that the stages make the updates
+//
+//      k = f(t + c_k dt, y)
+//      y = q + a_k dt k
+//      q = q + b_k dt k
+//
+// with y = q at the first stage, and a_k = a_{k+1,k} the coefficient of
+// the k-th stage in the next one, so that only y and k are kept between
+// stages. The last a_k is unused.
+template <size_t N>
+class LowStorage2RTableau{
+private:
+    std::array<double, N> _a;
+    std::array<double, N> _b;
+    std::array<double, N> _c;
+public:
+    // number of stages
+    static constexpr size_t nstages = N;
+
+    constexpr LowStorage2RTableau(std::array<double, N> a,
+                                  std::array<double, N> b,
+                                  std::array<double, N> c)
+        : _a (a) , _b (b) , _c (c) {}
+
+    template <size_t K>
+    constexpr double a() const {
+        static_assert(K < N, "invalid stage index");
+        return _a[K];
+    }
+
+    template <size_t K>
+    constexpr double b() const {
+        static_assert(K < N, "invalid stage index");
+        return _b[K];
+    }
+
+    template <size_t K>
+    constexpr double c() const {
+        static_assert(K < N, "invalid stage index");
+        return _c[K];
+    }
+
+    constexpr double operator () (char abc, int k) const {
+        switch (abc) {
+            case 'a': return _a[k];
+            case 'b': return _b[k];
+            case 'c': return _c[k];
+        }
+        throw std::invalid_argument("You must be joking!");
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Coefficients of an IMEX multistep method with S steps, making the update
+//
+//      (I - gamma dt A) u_{n+1} = sum_j alpha_j u_{n-j} + theta dt A u_n
+//                               + dt sum_j beta_j N(t_{n-j}, u_{n-j})
+//
+// for j = 0, ..., S-1, where A is the implicit and N the explicit term.
+template <size_t S>
+class MultistepTableau{
+private:
+    std::array<double, S> _alpha;
+    std::array<double, S> _beta;
+    double                _gamma;
+    double                _theta;
+public:
+    // number of steps
+    static constexpr size_t nsteps = S;
+
+    constexpr MultistepTableau(std::array<double, S> alpha,
+                               std::array<double, S> beta,
+                               double                gamma,
+                               double                theta)
+        : _alpha (alpha) , _beta (beta) , _gamma (gamma) , _theta (theta) {}
+
+    template <size_t J>
+    constexpr double alpha() const {
+        static_assert(J < S, "invalid step index");
+        return _alpha[J];
+    }
+
+    template <size_t J>
+    constexpr double beta() const {
+        static_assert(J < S, "invalid step index");
+        return _beta[J];
+    }
+
+    constexpr double gamma() const { return _gamma; }
+    constexpr double theta() const { return _theta; }
+};
+
+////////////////////////////////////////////////////////////////
+// Tableau of a Rosenbrock-W method, in the form of Hairer and Wanner that
+// avoids products with the Jacobian approximation J, with the stages
+//
+//      (I - gamma dt J) U_k = dt f(t + alpha_k dt, u + sum_j a_kj U_j) + sum_j c_kj U_j
+//
+// for j < k, and the solution u + sum_k m_k U_k.
+template <size_t N>
+class RosenbrockTableau{
+private:
+    std::array<std::array<double, N>, N> _a;
+    std::array<std::array<double, N>, N> _c;
+               std::array<double, N>     _m;
+               std::array<double, N>     _alpha;
+                          double         _gamma;
+public:
+    // number of stages
+    static constexpr size_t nstages = N;
+
+    constexpr RosenbrockTableau(std::array<std::array<double, N>, N> a,
+                                std::array<std::array<double, N>, N> c,
+                                           std::array<double, N>     m,
+                                           std::array<double, N>     alpha,
+                                                      double         gamma)
+        : _a (a) , _c (c) , _m (m) , _alpha (alpha) , _gamma (gamma) {}
+
+    template <size_t J, size_t K>
+    constexpr double a() const {
+        static_assert(J < N && K < N, "invalid stage index");
+        return _a[J][K];
+    }
+
+    template <size_t J, size_t K>
+    constexpr double c() const {
+        static_assert(J < N && K < N, "invalid stage index");
+        return _c[J][K];
+    }
+
+    template <size_t K>
+    constexpr double m() const {
+        static_assert(K < N, "invalid stage index");
+        return _m[K];
+    }
+
+    template <size_t K>
+    constexpr double alpha() const {
+        static_assert(K < N, "invalid stage index");
+        return _alpha[K];
+    }
+
+    constexpr double gamma() const { return _gamma; }
+};
+
 template <size_t N>
 class IMEXTableau{
 private:
     Tableau<N> IM;
     Tableau<N> EX;
+
+    template <char IMEX>
+    constexpr const Tableau<N>& _get() const {
+        static_assert(IMEX == 'I' || IMEX == 'E', "use 'I' or 'E'");
+        if constexpr (IMEX == 'I') {
+            return IM;
+        } else {
+            return EX;
+        }
+    }
+
 public:
-    IMEXTableau(Tableau<N> IM, Tableau<N> EX)
+    // number of stages
+    static constexpr size_t nstages = N;
+
+    constexpr IMEXTableau(Tableau<N> IM, Tableau<N> EX)
         : IM (IM) , EX (EX) {}
 
-    inline double operator () (char imex, char a, int j, int k) const {
+    template <char IMEX, size_t J, size_t K>
+    constexpr double a() const {
+        return _get<IMEX>().template a<J, K>();
+    }
+
+    template <char IMEX, size_t K>
+    constexpr double b() const {
+        return _get<IMEX>().template b<K>();
+    }
+
+    template <char IMEX, size_t K>
+    constexpr double c() const {
+        return _get<IMEX>().template c<K>();
+    }
+
+    constexpr double operator () (char imex, char a, int j, int k) const {
         switch (imex) {
             case 'I': return IM('a', j, k);
             case 'E': return EX('a', j, k);
         }
         throw std::invalid_argument("You must be joking!");
     }
-    inline double operator () (char imex, char bc, int k) const {
+    constexpr double operator () (char imex, char bc, int k) const {
         switch (imex) {
             case 'I': return IM(bc, k);
             case 'E': return EX(bc, k);
@@ -54,35 +347,264 @@ public:
     }
 };
 
+////////////////////////////////////////////////////////////////
+// IMEX tableau with embedded weights for the implicit and explicit
+// parts, defining a solution of lower order from the same stages, as
+// for EmbeddedTableau. The error weights are e = b - bhat.
+template <size_t N>
+class EmbeddedIMEXTableau : public IMEXTableau<N> {
+private:
+    std::array<double, N> _bhatI;
+    std::array<double, N> _bhatE;
+
+public:
+    // order of the solution and of the embedded solution
+    size_t order;
+    size_t embedded_order;
+
+    constexpr EmbeddedIMEXTableau(Tableau<N> IM, Tableau<N> EX,
+                                  std::array<double, N> bhatI,
+                                  std::array<double, N> bhatE,
+                                  size_t order,
+                                  size_t embedded_order)
+        : IMEXTableau<N> (IM, EX)
+        , _bhatI (bhatI)
+        , _bhatE (bhatE)
+        , order (order)
+        , embedded_order (embedded_order) {}
+
+    template <char IMEX, size_t K>
+    constexpr double bhat() const {
+        static_assert(IMEX == 'I' || IMEX == 'E', "use 'I' or 'E'");
+        static_assert(K < N, "invalid stage index");
+        return IMEX == 'I' ? _bhatI[K] : _bhatE[K];
+    }
+
+    template <char IMEX, size_t K>
+    constexpr double e() const {
+        return this->template b<IMEX, K>() - bhat<IMEX, K>();
+    }
+};
+
 ////////////////////////////////////////////////////////////////
 // Define tableaux as global variables
 
 // second order method
-static const Tableau<3> _CB2I = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
-                                  0.0 / 1.0,   2.0 / 5.0,   0.0 / 1.0,
-                                  0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
-                                 {0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
-                                 {0.0 / 1.0,   2.0 / 5.0,   1.0 / 1.0}};
-static const Tableau<3> _CB2E = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
-                                  2.0 / 5.0,   0.0 / 1.0,   0.0 / 1.0,
-                                  0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0},
-                                 {0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
-                                 {0.0 / 1.0,   2.0 / 5.0,   1.0 / 1.0}};
-static const IMEXTableau<3> CB2{_CB2I, _CB2E};
+inline constexpr Tableau<3> _CB2I = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                      0.0 / 1.0,   2.0 / 5.0,   0.0 / 1.0,
+                                      0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
+                                     {0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
+                                     {0.0 / 1.0,   2.0 / 5.0,   1.0 / 1.0}};
+inline constexpr Tableau<3> _CB2E = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                      2.0 / 5.0,   0.0 / 1.0,   0.0 / 1.0,
+                                      0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0},
+                                     {0.0 / 1.0,   5.0 / 6.0,   1.0 / 6.0},
+                                     {0.0 / 1.0,   2.0 / 5.0,   1.0 / 1.0}};
+// the embedded solution is first order
+inline constexpr EmbeddedIMEXTableau<3> CB2{_CB2I, _CB2E,
+                                            {0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0},
+                                            {0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0},
+                                            2, 1};
 
 // third order method
-static const Tableau<4> _CB3eI = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
-                                   0.0 / 1.0,   1.0 / 3.0,   0.0 / 1.0,  0.0 / 1.0,
-                                   0.0 / 1.0,   1.0 / 2.0,   1.0 / 2.0,  0.0 / 1.0,
-                                   0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
-                                  {0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
-                                  {0.0 / 1.0,   1.0 / 3.0,   1.0 / 1.0,  1.0 / 1.0}};
-static const Tableau<4> _CB3eE = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
-                                   1.0 / 3.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
-                                   0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
-                                   0.0 / 1.0,   3.0 / 4.0,   1.0 / 4.0,  0.0 / 1.0},
-                                  {0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
-                                  {0.0 / 1.0,   1.0 / 3.0,   1.0 / 1.0,  1.0 / 1.0}};
-static const IMEXTableau<4> CB3e{_CB3eI, _CB3eE};
+inline constexpr Tableau<4> _CB3eI = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
+                                       0.0 / 1.0,   1.0 / 3.0,   0.0 / 1.0,  0.0 / 1.0,
+                                       0.0 / 1.0,   1.0 / 2.0,   1.0 / 2.0,  0.0 / 1.0,
+                                       0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
+                                      {0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
+                                      {0.0 / 1.0,   1.0 / 3.0,   1.0 / 1.0,  1.0 / 1.0}};
+inline constexpr Tableau<4> _CB3eE = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
+                                       1.0 / 3.0,   0.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
+                                       0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0,  0.0 / 1.0,
+                                       0.0 / 1.0,   3.0 / 4.0,   1.0 / 4.0,  0.0 / 1.0},
+                                      {0.0 / 1.0,   3.0 / 4.0,  -1.0 / 4.0,  1.0 / 2.0},
+                                      {0.0 / 1.0,   1.0 / 3.0,   1.0 / 1.0,  1.0 / 1.0}};
+// The embedded solution is second order, i.e. sum(bhat) = 1 and
+// sum(bhat * c) = 1/2 for both parts, which also gives the coupling
+// conditions because the two parts have the same nodes c. The weights
+// use the stages at c = 0 and c = 1, as the two stages at c = 1 alone
+// give no estimate when the implicit and explicit terms are equal
+inline constexpr EmbeddedIMEXTableau<4> CB3e{_CB3eI, _CB3eE,
+                                             {1.0 / 2.0,   0.0 / 1.0,   1.0 / 2.0,   0.0 / 1.0},
+                                             {1.0 / 2.0,   0.0 / 1.0,   1.0 / 2.0,   0.0 / 1.0},
+                                             3, 2};
+
+// Fourth order method with the 4R3R structure, see steps/cb4r3r.hpp. The
+// coefficients solve the order conditions of additive methods, with the
+// same weights and nodes for both parts, so that the coupling conditions
+// reduce to those of each part. The implicit part is stiffly accurate and
+// L-stable, with diagonal 1/4, and the first stage is explicit.
+inline constexpr Tableau<6> _CB4I = {{ 0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.18534344716101087,  0.25000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.22840136956710855,  0.13932441045733271,  0.25000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.21279311527767333, -1.00950036303574708,  0.75568844619540687,  0.25000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.21279311527767333,  0.41868005881847387, -0.02968730732356877, -0.05922048086297753,  0.25000000000000000,  0.00000000000000000,
+                                       0.21279311527767333,  0.41868005881847387,  0.61876574496134107, -0.14046795846646717, -0.35977096059102093,  0.25000000000000000},
+                                     { 0.21279311527767333,  0.41868005881847387,  0.61876574496134107, -0.14046795846646717, -0.35977096059102093,  0.25000000000000000},
+                                     { 0.00000000000000000,  0.43534344716101087,  0.61772578002444123,  0.20898119843733309,  0.79256538590960102,  1.00000000000000000}};
+inline constexpr Tableau<6> _CB4E = {{ 0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.43534344716101087,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.13538663871778453,  0.48233914130665667,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.21279311527767333,  0.11451427982985901, -0.11832619667019927,  0.00000000000000000,  0.00000000000000000,  0.00000000000000000,
+                                       0.21279311527767333,  0.41868005881847387, -0.18129789262546980,  0.34239010443892348,  0.00000000000000000,  0.00000000000000000,
+                                       0.21279311527767333,  0.41868005881847387,  0.61876574496134107,  0.04827688242703232, -0.29851580148452050,  0.00000000000000000},
+                                     { 0.21279311527767333,  0.41868005881847387,  0.61876574496134107, -0.14046795846646717, -0.35977096059102093,  0.25000000000000000},
+                                     { 0.00000000000000000,  0.43534344716101087,  0.61772578002444123,  0.20898119843733309,  0.79256538590960102,  1.00000000000000000}};
+inline constexpr IMEXTableau<6> CB4{_CB4I, _CB4E};
+
+// explicit methods, see steps/explicitrk.hpp
+
+// second order method of Ralston, with minimum error bound
+inline constexpr Tableau<2> Ralston2 = {{0.0 / 1.0,   0.0 / 1.0,
+                                         2.0 / 3.0,   0.0 / 1.0},
+                                        {1.0 / 4.0,   3.0 / 4.0},
+                                        {0.0 / 1.0,   2.0 / 3.0}};
+
+// third order strong stability preserving method of Shu and Osher
+inline constexpr Tableau<3> SSPRK3 = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                       1.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                       1.0 / 4.0,   1.0 / 4.0,   0.0 / 1.0},
+                                      {1.0 / 6.0,   1.0 / 6.0,   2.0 / 3.0},
+                                      {0.0 / 1.0,   1.0 / 1.0,   1.0 / 2.0}};
+
+// classical fourth order method
+inline constexpr Tableau<4> Classic4 = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                         1.0 / 2.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                         0.0 / 1.0,   1.0 / 2.0,   0.0 / 1.0,   0.0 / 1.0,
+                                         0.0 / 1.0,   0.0 / 1.0,   1.0 / 1.0,   0.0 / 1.0},
+                                        {1.0 / 6.0,   1.0 / 3.0,   1.0 / 3.0,   1.0 / 6.0},
+                                        {0.0 / 1.0,   1.0 / 2.0,   1.0 / 2.0,   1.0 / 1.0}};
+
+// fifth order method of Butcher
+inline constexpr Tableau<6> Butcher5 = {{ 0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                          1.0 / 4.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                          1.0 / 8.0,   1.0 / 8.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                          0.0 / 1.0,  -1.0 / 2.0,   1.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                          3.0 / 16.0,  0.0 / 1.0,   0.0 / 1.0,   9.0 / 16.0,  0.0 / 1.0,   0.0 / 1.0,
+                                         -3.0 / 7.0,   2.0 / 7.0,  12.0 / 7.0, -12.0 / 7.0,   8.0 / 7.0,   0.0 / 1.0},
+                                        { 7.0 / 90.0,  0.0 / 1.0,  32.0 / 90.0, 12.0 / 90.0, 32.0 / 90.0,  7.0 / 90.0},
+                                        { 0.0 / 1.0,   1.0 / 4.0,   1.0 / 4.0,   1.0 / 2.0,   3.0 / 4.0,   1.0 / 1.0}};
+
+// embedded pairs, see steps/embeddedrk.hpp
+
+// third order method of Bogacki and Shampine, with second order estimate
+inline constexpr EmbeddedTableau<4> BS32 = {{0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                             1.0 / 2.0,   0.0 / 1.0,   0.0 / 1.0,   0.0 / 1.0,
+                                             0.0 / 1.0,   3.0 / 4.0,   0.0 / 1.0,   0.0 / 1.0,
+                                             2.0 / 9.0,   1.0 / 3.0,   4.0 / 9.0,   0.0 / 1.0},
+                                            {2.0 / 9.0,   1.0 / 3.0,   4.0 / 9.0,   0.0 / 1.0},
+                                            {7.0 / 24.0,  1.0 / 4.0,   1.0 / 3.0,   1.0 / 8.0},
+                                            {0.0 / 1.0,   1.0 / 2.0,   3.0 / 4.0,   1.0 / 1.0},
+                                            3, 2};
+
+// fifth order method of Dormand and Prince, with fourth order estimate
+inline constexpr EmbeddedTableau<7> DP54 = {{    0.0 / 1.0,        0.0 / 1.0,       0.0 / 1.0,      0.0 / 1.0,        0.0 / 1.0,       0.0 / 1.0,  0.0 / 1.0,
+                                                 1.0 / 5.0,        0.0 / 1.0,       0.0 / 1.0,      0.0 / 1.0,        0.0 / 1.0,       0.0 / 1.0,  0.0 / 1.0,
+                                                 3.0 / 40.0,       9.0 / 40.0,      0.0 / 1.0,      0.0 / 1.0,        0.0 / 1.0,       0.0 / 1.0,  0.0 / 1.0,
+                                                44.0 / 45.0,     -56.0 / 15.0,     32.0 / 9.0,      0.0 / 1.0,        0.0 / 1.0,       0.0 / 1.0,  0.0 / 1.0,
+                                             19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0,   0.0 / 1.0,       0.0 / 1.0,  0.0 / 1.0,
+                                              9017.0 / 3168.0,   -355.0 / 33.0,   46732.0 / 5247.0,   49.0 / 176.0, -5103.0 / 18656.0, 0.0 / 1.0,  0.0 / 1.0,
+                                                35.0 / 384.0,      0.0 / 1.0,     500.0 / 1113.0,   125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0 / 1.0},
+                                            {   35.0 / 384.0,      0.0 / 1.0,     500.0 / 1113.0,   125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0 / 1.0},
+                                            { 5179.0 / 57600.0,    0.0 / 1.0,    7571.0 / 16695.0,  393.0 / 640.0, -92097.0 / 339200.0, 187.0 / 2100.0, 1.0 / 40.0},
+                                            {    0.0 / 1.0,        1.0 / 5.0,       3.0 / 10.0,     4.0 / 5.0,        8.0 / 9.0,       1.0 / 1.0,  1.0 / 1.0},
+                                            5, 4};
+
+// low storage methods, see steps/lowstoragerk.hpp
+
+// third order method of Williamson
+inline constexpr LowStorageTableau<3> Williamson3 = {{  0.0 / 1.0,  -5.0 / 9.0, -153.0 / 128.0},
+                                                     {  1.0 / 3.0,  15.0 / 16.0,   8.0 / 15.0},
+                                                     {  0.0 / 1.0,   1.0 / 3.0,    3.0 / 4.0}};
+
+// fourth order, five stage method of Carpenter and Kennedy
+inline constexpr LowStorageTableau<5> CarpenterKennedy4 = {{ 0.0 / 1.0,
+                                                            -567301805773.0 / 1357537059087.0,
+                                                            -2404267990393.0 / 2016746695238.0,
+                                                            -3550918686646.0 / 2091501179385.0,
+                                                            -1275806237668.0 / 842570457699.0},
+                                                           { 1432997174477.0 / 9575080441755.0,
+                                                             5161836677717.0 / 13612068292357.0,
+                                                             1720146321549.0 / 2090206949498.0,
+                                                             3134564353537.0 / 4481467310338.0,
+                                                             2277821191437.0 / 14882151754819.0},
+                                                           { 0.0 / 1.0,
+                                                             1432997174477.0 / 9575080441755.0,
+                                                             2526269341429.0 / 6820363962896.0,
+                                                             2006345519317.0 / 3224310063776.0,
+                                                             2802321613138.0 / 2924317926251.0}};
+
+// fifth order, nine stage method in the 2R form, see Kennedy, Carpenter and Lewis
+// (2000), where nine stages give as many coefficients as the seventeen order
+// conditions. The coefficients solve them to round-off, with all nodes in [0, 1]
+inline constexpr LowStorage2RTableau<9> LowStorage2R5 = {{ 0.20527603933034935,
+                                                           0.13979012363421811,
+                                                           0.34464240262791085,
+                                                           0.36779916253612005,
+                                                           0.089080998178444296,
+                                                           0.2299889902113875,
+                                                           0.41144092251472114,
+                                                           0.20162071088102126,
+                                                           0.0},
+                                                         { 0.087119784187362201,
+                                                          -0.016722291573079799,
+                                                           0.24739630828923687,
+                                                           0.23134445789479016,
+                                                          -0.15561027325673424,
+                                                           0.038764682319083262,
+                                                           0.24066641244519452,
+                                                           0.092692081768889392,
+                                                           0.23434883792525757},
+                                                         { 0.0,
+                                                           0.20527603933034935,
+                                                           0.22690990782158033,
+                                                           0.41503989524219326,
+                                                           0.68559296343963927,
+                                                           0.63821925697675375,
+                                                           0.62351697575296272,
+                                                           0.84373359037537965,
+                                                           0.87457979118687423}};
+
+// IMEX multistep methods, see steps/multistep.hpp
+
+// Crank-Nicolson for the implicit and second order Adams-Bashforth for the explicit term
+inline constexpr MultistepTableau<2> CNAB2 = {{  1.0 / 1.0,   0.0 / 1.0},
+                                              {  3.0 / 2.0,  -1.0 / 2.0},
+                                                 1.0 / 2.0,   1.0 / 2.0};
+
+// second order semi-implicit backward differentiation formula
+inline constexpr MultistepTableau<2> SBDF2 = {{  4.0 / 3.0,  -1.0 / 3.0},
+                                              {  4.0 / 3.0,  -2.0 / 3.0},
+                                                 2.0 / 3.0,   0.0 / 1.0};
+
+// third order semi-implicit backward differentiation formula
+inline constexpr MultistepTableau<3> SBDF3 = {{ 18.0 / 11.0, -9.0 / 11.0,  2.0 / 11.0},
+                                              { 18.0 / 11.0, -18.0 / 11.0, 6.0 / 11.0},
+                                                 6.0 / 11.0,  0.0 / 1.0};
+
+// Rosenbrock-W methods, see steps/rosenbrock.hpp
+
+// second order, L-stable method of Verwer et al, second order for any Jacobian approximation
+inline constexpr RosenbrockTableau<2> ROS2 = {{ 0.0 / 1.0,  0.0 / 1.0,
+                                                1.0 / 1.0,  0.0 / 1.0},
+                                              { 0.0 / 1.0,  0.0 / 1.0,
+                                               -2.0 / 1.0,  0.0 / 1.0},
+                                              { 3.0 / 2.0,  1.0 / 2.0},
+                                              { 0.0 / 1.0,  1.0 / 1.0},
+                                                1.70710678118654752};
+
+// third order, L-stable method ROS34PW2 of Rang and Angermann, third order
+// for any Jacobian approximation, converted to the form without products
+inline constexpr RosenbrockTableau<4> ROS34PW2 = {{ 0.0,                  0.0,                  0.0,                 0.0,
+                                                    0.87173304301691801,  0.0,                  0.0,                 0.0,
+                                                    0.61858931542401074, -0.11299064236484185,  0.0,                 0.0,
+                                                    1.8239969947745147,  -0.12430565256671987,  1.0,                 0.0},
+                                                  { 0.0,                  0.0,                  0.0,                 0.0,
+                                                   -2.0,                  0.0,                  0.0,                 0.0,
+                                                   -1.8239969947745147,   0.12430565256671987,  0.0,                 0.0,
+                                                   -2.7756761163024688,  -2.9619836625547888,   1.2509798950560600,  0.0},
+                                                  { 1.8239969947745147,  -0.12430565256671987,  1.0,                 0.43586652150845900},
+                                                  { 0.0,                  0.87173304301691801,  0.73157995778885243, 1.0},
+                                                    0.43586652150845900};
 
 }
\ No newline at end of file
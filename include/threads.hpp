@@ -0,0 +1,319 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Flows {
+
+////////////////////////////////////////////////////////////////
+// A minimal pool of worker threads. The only operation is 'run',
+// which executes a task over a number of chunks and returns when
+// all chunks are done. The calling thread takes part in the work,
+// so a pool of n threads spawns n-1 workers.
+class ThreadPool {
+private:
+    std::vector<std::thread>                   _workers;
+    std::mutex                                 _mutex;
+    std::mutex                                 _run_mutex;
+    std::condition_variable                    _cv_work;
+    std::condition_variable                    _cv_done;
+    const std::function<void(std::size_t)>*    _task;
+    std::size_t                                _nchunks;
+    std::atomic<std::size_t>                   _next;
+    std::size_t                                _busy;
+    std::size_t                                _generation;
+    bool                                       _stop;
+
+    // take chunks until there are none left
+    void _work() {
+        for (auto k = _next++; k < _nchunks; k = _next++)
+            (*_task)(k);
+    }
+
+    // main loop of the workers. Each worker waits for a new
+    // generation of work, i.e. a new call to 'run'
+    void _loop() {
+        std::size_t seen = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv_work.wait(lock, [&] { return _stop || _generation != seen; });
+            if (_stop)
+                return;
+            seen = _generation;
+            lock.unlock();
+
+            _work();
+
+            lock.lock();
+            if (--_busy == 0)
+                _cv_done.notify_one();
+        }
+    }
+
+public:
+    // constructor
+    ThreadPool(std::size_t nthreads)
+        : _task(nullptr)
+        , _nchunks(0)
+        , _next(0)
+        , _busy(0)
+        , _generation(0)
+        , _stop(false) {
+        for (std::size_t i = 1; i < nthreads; i++)
+            _workers.emplace_back([this] { _loop(); });
+    }
+
+    // join the workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv_work.notify_all();
+        for (auto& worker : _workers)
+            worker.join();
+    }
+
+    // non copyable
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of threads, including the calling thread
+    std::size_t size() const { return _workers.size() + 1; }
+
+    // run task(k) for k in [0, nchunks)
+    void run(std::size_t nchunks, const std::function<void(std::size_t)>& task) {
+        if (_workers.empty() || nchunks < 2) {
+            for (std::size_t k = 0; k != nchunks; k++)
+                task(k);
+            return;
+        }
+
+        // one call at a time, if the pool is shared by several user threads
+        std::lock_guard<std::mutex> run_lock(_run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task    = &task;
+            _nchunks = nchunks;
+            _next    = 0;
+            _busy    = _workers.size();
+            _generation++;
+        }
+        _cv_work.notify_all();
+
+        _work();
+
+        // wait for all workers to be done with this generation
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv_done.wait(lock, [&] { return _busy == 0; });
+        _task = nullptr;
+    }
+};
+
+////////////////////////////////////////////////////////////////
+// Global settings for parallel execution. Assignment of coupled
+// objects is serial by default. Parallel execution is enabled with
+// set_num_threads(n), with n > 1, and components with at least
+// 'threshold' elements have their index range split across threads.
+struct _ParallelSettings {
+    std::unique_ptr<ThreadPool> pool;
+    std::size_t                 threshold = 1 << 15;
+};
+
+inline _ParallelSettings& _parallel_settings() {
+    static _ParallelSettings settings;
+    return settings;
+}
+
+// set the number of threads, including the calling thread
+inline void set_num_threads(std::size_t nthreads) {
+    auto& settings = _parallel_settings();
+    settings.pool.reset();
+    if (nthreads > 1)
+        settings.pool = std::make_unique<ThreadPool>(nthreads);
+}
+
+inline std::size_t get_num_threads() {
+    auto& settings = _parallel_settings();
+    return settings.pool ? settings.pool->size() : 1;
+}
+
+// set the minimum number of elements of a component for the
+// assignment to be split across threads
+inline void set_parallel_threshold(std::size_t threshold) {
+    _parallel_settings().threshold = threshold;
+}
+
+inline std::size_t get_parallel_threshold() {
+    return _parallel_settings().threshold;
+}
+
+// size of the chunks used to split the range [0, size) across
+// threads, rounded up to a multiple of 'align' elements
+inline std::size_t _chunk_size(std::size_t size, std::size_t nthreads, std::size_t align) {
+    std::size_t chunk = (size + nthreads - 1) / nthreads;
+    return (chunk + align - 1) / align * align;
+}
+
+// Split the range [0, size) into chunks, one per thread, with boundaries
+// aligned to 'align' elements, and call f(begin, end) on each of them.
+// Runs serially if the range is below the threshold.
+template <typename F>
+inline void _parallel_for(std::size_t size, std::size_t align, F&& f) {
+    auto& settings = _parallel_settings();
+    if (!settings.pool || size < settings.threshold) {
+        f(std::size_t(0), size);
+        return;
+    }
+
+    std::size_t chunk   = _chunk_size(size, settings.pool->size(), align);
+    std::size_t nchunks = (size + chunk - 1) / chunk;
+
+    settings.pool->run(nchunks, [&](std::size_t k) {
+        std::size_t begin = k * chunk;
+        std::size_t end   = begin + chunk < size ? begin + chunk : size;
+        f(begin, end);
+    });
+}
+
+// Same as above, but f(begin, end) returns a partial result. The partial
+// results are combined in chunk order, so that, for a given number of
+// threads, the result does not depend on the scheduling of the chunks.
+template <typename T, typename F, typename C>
+inline T _parallel_reduce(std::size_t size, std::size_t align, T init, F&& f, C&& combine) {
+    auto& settings = _parallel_settings();
+    if (!settings.pool || size < settings.threshold)
+        return f(std::size_t(0), size);
+
+    std::size_t chunk   = _chunk_size(size, settings.pool->size(), align);
+    std::size_t nchunks = (size + chunk - 1) / chunk;
+
+    std::vector<T> partials(nchunks, init);
+    settings.pool->run(nchunks, [&](std::size_t k) {
+        std::size_t begin = k * chunk;
+        std::size_t end   = begin + chunk < size ? begin + chunk : size;
+        partials[k]       = f(begin, end);
+    });
+
+    T result = init;
+    for (const auto& partial : partials)
+        result = combine(result, partial);
+    return result;
+}
+
+////////////////////////////////////////////////////////////////
+// A single worker thread running tasks in the order of submission,
+// e.g. for input and output overlapping with the computation. Each
+// task gets a ticket, and 'wait' returns when the task is done.
+// An exception thrown by a task is rethrown by the next call to
+// 'wait', and later tasks are discarded.
+class TaskQueue {
+private:
+    std::thread                        _worker;
+    std::mutex                         _mutex;
+    std::condition_variable            _cv_work;
+    std::condition_variable            _cv_done;
+    std::deque<std::function<void()>>  _tasks;
+    std::size_t                        _nsubmitted;
+    std::size_t                        _ndone;
+    std::exception_ptr                 _error;
+    bool                               _stop;
+
+    void _loop() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv_work.wait(lock, [&] { return _stop || !_tasks.empty(); });
+            if (_tasks.empty())
+                return;
+            auto task = std::move(_tasks.front());
+            _tasks.pop_front();
+            const bool skip = bool(_error);
+            lock.unlock();
+
+            std::exception_ptr error;
+            if (!skip) {
+                try {
+                    task();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+
+            lock.lock();
+            if (error)
+                _error = error;
+            _ndone++;
+            _cv_done.notify_all();
+        }
+    }
+
+public:
+    TaskQueue()
+        : _nsubmitted(0)
+        , _ndone(0)
+        , _stop(false) {
+        _worker = std::thread([this] { _loop(); });
+    }
+
+    // run the remaining tasks and join the worker
+    ~TaskQueue() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv_work.notify_one();
+        _worker.join();
+    }
+
+    // non copyable
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    // submit a task and return its ticket
+    std::size_t submit(std::function<void()> task) {
+        std::size_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back(std::move(task));
+            ticket = ++_nsubmitted;
+        }
+        _cv_work.notify_one();
+        return ticket;
+    }
+
+    // whether the task with the given ticket is done
+    bool done(std::size_t ticket) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _ndone >= ticket;
+    }
+
+    // wait until the task with the given ticket is done
+    void wait(std::size_t ticket) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv_done.wait(lock, [&] { return _ndone >= ticket; });
+        if (_error) {
+            auto error = _error;
+            _error     = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    // wait until all submitted tasks are done
+    void wait() {
+        std::size_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ticket = _nsubmitted;
+        }
+        wait(ticket);
+    }
+};
+}
@@ -29,6 +29,12 @@ inline void _ImcA_mul(vec3& dudt, const vec3& u, double c) {
     dudt[2] = u[2] * (1.0 - c * (-8.0 / 3.0));
 }
 
+inline void _phi(vec3& dudt, const vec3& u, double c, std::size_t k) {
+    dudt[0] = Flows::phi(k, c * (-10.0)) * u[0];
+    dudt[1] = Flows::phi(k, c * (-1.0)) * u[1];
+    dudt[2] = Flows::phi(k, c * (-8.0 / 3.0)) * u[2];
+}
+
 /* Nonlinear equations */
 // We split the equations into explicit and implicit components, for testing purposes.
 struct Lorenz {
@@ -56,6 +62,10 @@ struct Lorenz {
     inline void ImcA_div(vec3& dudt, const vec3& u, double c) {
         _ImcA_div(dudt, u, c);
     }
+
+    inline void phi(vec3& dudt, const vec3& u, double c, std::size_t k) {
+        _phi(dudt, u, c, k);
+    }
 };
 
 struct LorenzTan {
@@ -83,6 +93,10 @@ struct LorenzTan {
     inline void ImcA_div(vec3& dudt, const vec3& u, double c) {
         _ImcA_div(dudt, u, c);
     }
+
+    inline void phi(vec3& dudt, const vec3& u, double c, std::size_t k) {
+        _phi(dudt, u, c, k);
+    }
 };
 
 struct LorenzAdj {
@@ -111,4 +125,8 @@ struct LorenzAdj {
     inline void ImcA_div(vec3& dudt, const vec3& u, double c) {
         _ImcA_div(dudt, u, c);
     }
+
+    inline void phi(vec3& dudt, const vec3& u, double c, std::size_t k) {
+        _phi(dudt, u, c, k);
+    }
 };
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstddef>
+#include <limits>
+#include <vector>
 
 struct ImplicitTerm {
     double _lambda;
@@ -16,6 +19,11 @@ struct ImplicitTerm {
         z = y * (1 - c * _lambda);
     }
 
+    // implicit term - return z = phi_k(cA)*y
+    inline void phi(double& z, const double y, double c, std::size_t k) {
+        z = Flows::phi(k, c * _lambda) * y;
+    }
+
     // implicit term A = 0: calculates out = A*x
     inline void mul(double& out, const double x) {
         out = x * _lambda;
@@ -33,3 +41,106 @@ struct ExplicitTerm {
         dxdt = _lambda * x;
     }
 };
+
+// explicit term x' = x, which is not defined past x_max, where it is NaN
+struct BlowUpTerm {
+    double _x_max;
+
+    BlowUpTerm(double x_max)
+        : _x_max(x_max) {}
+
+    inline void operator()(double t, double x, double& dxdt) {
+        dxdt = x < _x_max ? x : std::numeric_limits<double>::quiet_NaN();
+    }
+};
+
+// stiff nonlinear term -k x^3, with its Jacobian for linearly implicit methods
+struct CubicTerm {
+    double _k;
+    double _J;
+
+    CubicTerm(double k)
+        : _k(k)
+        , _J(0) {}
+
+    inline void operator()(double t, double x, double& dxdt) {
+        dxdt = -_k * x * x * x;
+    }
+
+    // Jacobian at x
+    inline void jacobian(double t, double x) {
+        _J = -3 * _k * x * x;
+    }
+
+    // return z that solves (I - cJ)*z = y
+    inline void ImcJ_div(double& z, const double y, double c) {
+        z = y / (1 - c * _J);
+    }
+};
+// nonlinear implicit term -k x^3, only available through mul
+struct CubicImplicitTerm {
+    double _k;
+
+    CubicImplicitTerm(double k)
+        : _k(k) {}
+
+    inline void mul(double& out, const double x) {
+        out = -_k * x * x * x;
+    }
+};
+
+// Allen-Cahn equation u_t = nu u_xx + u - u^3 on a periodic grid with
+// spacing h, as a nonlinear implicit term only available through mul
+struct AllenCahnTerm {
+    double _nu;
+    double _h;
+
+    AllenCahnTerm(double nu, double h)
+        : _nu(nu)
+        , _h(h) {}
+
+    inline void mul(std::vector<double>& out, const std::vector<double>& u) {
+        std::size_t n = u.size();
+        double      s = _nu / (_h * _h);
+        for (std::size_t i = 0; i != n; i++) {
+            double l = u[(i + n - 1) % n];
+            double r = u[(i + 1) % n];
+            out[i]   = s * (l - 2 * u[i] + r) + u[i] - u[i] * u[i] * u[i];
+        }
+    }
+};
+
+// zero explicit term
+struct ZeroTerm {
+    inline void operator()(double t, const std::vector<double>& u, std::vector<double>& dudt) {
+        for (auto& d : dudt)
+            d = 0;
+    }
+};
+
+// preconditioner for the Allen-Cahn term, approximating the inverse of
+// I - c nu d_xx with a few Jacobi sweeps, which are linear in the input
+struct AllenCahnPreconditioner {
+    double              _nu;
+    double              _h;
+    std::vector<double> _tmp;
+
+    AllenCahnPreconditioner(double nu, double h)
+        : _nu(nu)
+        , _h(h) {}
+
+    template <typename Z>
+    inline void operator()(Z& zout, const Z& zin, double c) {
+        auto&       out = std::get<0>(zout);
+        const auto& in  = std::get<0>(zin);
+        std::size_t n   = in.size();
+        double      s   = c * _nu / (_h * _h);
+        for (std::size_t i = 0; i != n; i++)
+            out[i] = in[i] / (1 + 2 * s);
+        for (int k = 0; k != 3; k++) {
+            _tmp = out;
+            for (std::size_t i = 0; i != n; i++)
+                out[i] = (in[i] + s * (_tmp[(i + n - 1) % n] + _tmp[(i + 1) % n])) / (1 + 2 * s);
+        }
+    }
+};
@@ -5,6 +5,8 @@
 #include <valarray>
 #include <cmath>
 #include <chrono>
+#include <tuple>
+#include <vector>
 
 TEST_CASE("Testing Bench", "[bench]") {
     
@@ -49,4 +51,59 @@ TEST_CASE("Testing Bench", "[bench]") {
 
     // difference in time must be < than 5%, mostly due to noise
     REQUIRE( std::fabs(elapsed_1.count() - elapsed_2.count())/elapsed_1.count() < 0.05);
-}
\ No newline at end of file
+}
+TEST_CASE("Testing Bench bandwidth", "[bench]") {
+
+    // large components, so that data does not fit in cache and the
+    // assignment is bound by memory bandwidth. We use std::vector to
+    // check that the fast path for contiguous storage is taken
+    std::size_t N = 1 << 21;
+    std::vector<double> x1(N, 2), y1(N, 2);
+    std::vector<double> x2(N, 2), y2(N, 2);
+    std::vector<double> x3(N, 2), y3(N, 2);
+
+    auto a = Flows::couple(x1, y1, 5.0);
+    auto b = Flows::couple(x2, y2, 6.0);
+    auto c = Flows::couple(x3, y3, 0.0);
+
+    // take the minimum over several repetitions to filter out noise
+    double elapsed_1 = 1e10;
+    double elapsed_2 = 1e10;
+    for (int rep = 0; rep != 10; rep++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        c = 2 * a + 3 * b - a * 2 + b / 1.5;
+        auto end = std::chrono::high_resolution_clock::now();
+        elapsed_1 = std::min(elapsed_1, std::chrono::duration<double>(end - start).count());
+
+        // reference is a hand written loop over raw pointers
+        start = std::chrono::high_resolution_clock::now();
+        for (auto [pa, pb, pc] : { std::make_tuple(x1.data(), x2.data(), x3.data()),
+                                   std::make_tuple(y1.data(), y2.data(), y3.data()) })
+            for (std::size_t i = 0; i != N; i++)
+                pc[i] = 2 * pa[i] + 3 * pb[i] - pa[i] * 2 + pb[i] / 1.5;
+        end = std::chrono::high_resolution_clock::now();
+        elapsed_2 = std::min(elapsed_2, std::chrono::duration<double>(end - start).count());
+    }
+
+    REQUIRE(std::get<0>(c, N - 1) == 2 * 2 + 3 * 2 - 2 * 2 + 2 / 1.5);
+    REQUIRE(std::get<2>(c) == 2 * 5.0 + 3 * 6.0 - 5.0 * 2 + 6.0 / 1.5);
+
+    // effective bandwidth in GB/s: two loads and one store per element
+    double bandwidth_1 = 2 * 3 * N * sizeof(double) / elapsed_1 / 1e9;
+    double bandwidth_2 = 2 * 3 * N * sizeof(double) / elapsed_2 / 1e9;
+
+    // the assignment takes the fast path for both vector components. The
+    // element-wise loop can be vectorised just as well for this expression,
+    // so the timings alone would not show its loss
+    using E = decltype(2 * a + 3 * b - a * 2 + b / 1.5);
+    REQUIRE(Flows::_is_contiguous_v<std::vector<double>>);
+    REQUIRE(Flows::_is_bindable<0, E>::value);
+    REQUIRE(Flows::_is_bindable<1, E>::value);
+
+    // The fast path should reach the bandwidth of the hand written loop.
+    // Wall-clock ratios are noisy on loaded machines, so the ratio is
+    // reported, and only required not to collapse
+    WARN("bandwidth " << bandwidth_1 << " GB/s, hand written loop "
+                      << bandwidth_2 << " GB/s, ratio " << bandwidth_1 / bandwidth_2);
+    REQUIRE(bandwidth_1 / bandwidth_2 > 0.5);
+}
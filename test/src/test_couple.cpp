@@ -1,6 +1,7 @@
 #include <cmath>
 #include <iostream>
 #include <valarray>
+#include <vector>
 
 #include "Flows.hpp"
 #include "catch.hpp"
@@ -86,6 +87,53 @@ TEST_CASE("coupled", "tests") {
         REQUIRE(std::get<0>(mon2.samples()[2]) - std::exp(1.0) < 1e-12);
     }
 
+    SECTION("variadic integration") {
+
+        // state, two tangent directions and a quadrature
+        double x  = 1.0;
+        double y1 = 1.0;
+        double y2 = 2.0;
+        double q  = 0.0;
+
+        // define system. The k-th function receives components 0 to k
+        ExplicitTerm exTerm(0.5);
+        ImplicitTerm imTerm(0.5);
+        auto         tan1 = [](double t, const double& x, const double& dxdt,
+                           const double& y1, double& dy1dt) {
+            dy1dt = 0.5 * y1;
+        };
+        auto tan2 = [](double t, const double& x, const double& dxdt,
+                        const double& y1, const double& dy1dt,
+                        const double& y2, double& dy2dt) {
+            dy2dt = 0.5 * y2;
+        };
+        auto quad4 = [](double t, const double& x, const double& dxdt,
+                         const double& y1, const double& dy1dt,
+                         const double& y2, const double& dy2dt,
+                         const double& q, double& dqdt) {
+            dqdt = x;
+        };
+        auto noop = NoOpFunction();
+        auto sys  = System(std::forward_as_tuple(exTerm, tan1, tan2, quad4),
+            std::forward_as_tuple(imTerm, imTerm, imTerm, noop));
+
+        // define method
+        auto m = CB3R2R_3E(couple(0.0, 0.0, 0.0, 0.0));
+
+        // define integrator
+        auto stepping = TimeStepConstant(1e-4);
+        auto phi      = Flow(sys, m, stepping);
+
+        // propagate
+        auto z = refcouple(x, y1, y2, q);
+        phi(z, 0.0, 1.0);
+
+        REQUIRE(std::fabs(x - std::exp(1.0)) < 1e-12);
+        REQUIRE(std::fabs(y1 - std::exp(1.0)) < 1e-12);
+        REQUIRE(std::fabs(y2 - 2 * std::exp(1.0)) < 1e-12);
+        REQUIRE(std::fabs(q - std::exp(1.0) + 1.0) < 1e-12);
+    }
+
     SECTION("arithmetic") {
 
         // initial condition
@@ -125,6 +173,147 @@ TEST_CASE("coupled", "tests") {
         REQUIRE(std::get<2>(c) == 0);
     }
 
+    SECTION("parallel assignment") {
+
+        std::size_t N = 100003;
+        std::vector<double> x1(N), y1(N), x2(N), y2(N);
+        for (std::size_t i = 0; i != N; i++) {
+            x1[i] = i;
+            y1[i] = 2.0 * i;
+        }
+        auto a = couple(x1, y1, 1.0);
+        auto b = couple(x2, y2, 0.0);
+        auto c = couple(x2, y2, 0.0);
+
+        // serial
+        b = 2.0 * a + a / 4.0;
+
+        // split across four threads
+        set_num_threads(4);
+        set_parallel_threshold(1000);
+        REQUIRE(get_num_threads() == 4);
+        c = 2.0 * a + a / 4.0;
+        REQUIRE(std::get<0>(c) == std::get<0>(b));
+        REQUIRE(std::get<1>(c) == std::get<1>(b));
+        REQUIRE(std::get<2>(c) == std::get<2>(b));
+
+        // set to value
+        c = 1.0;
+        REQUIRE(std::get<0>(c) == std::vector<double>(N, 1.0));
+
+        // back to serial execution
+        set_num_threads(1);
+        set_parallel_threshold(1 << 15);
+        REQUIRE(get_num_threads() == 1);
+    }
+
+    SECTION("multiple assignment") {
+
+        std::size_t N = 1001;
+        std::vector<double> x1(N), y1(N), x2(N), y2(N);
+        for (std::size_t i = 0; i != N; i++) {
+            x1[i] = i;
+            y1[i] = 2.0 * i;
+            x2[i] = 3.0 * i;
+            y2[i] = 4.0 * i;
+        }
+        auto a = couple(x1, y1, 1.0);
+        auto b = couple(x2, y2, 2.0);
+
+        // expected values, with temporaries
+        auto a_ = couple(x1, y1, 1.0);
+        auto b_ = couple(x2, y2, 2.0);
+        auto t  = couple(x1, y1, 1.0);
+        t       = a_ + 2.0 * b_;
+        b_      = a_ - b_ / 4.0;
+        a_      = t;
+
+        // the expressions see the values before the assignment
+        assign_all(a, a + 2.0 * b, b, a - b / 4.0);
+        REQUIRE(std::get<0>(a) == std::get<0>(a_));
+        REQUIRE(std::get<1>(a) == std::get<1>(a_));
+        REQUIRE(std::get<2>(a) == std::get<2>(a_));
+        REQUIRE(std::get<0>(b) == std::get<0>(b_));
+        REQUIRE(std::get<1>(b) == std::get<1>(b_));
+        REQUIRE(std::get<2>(b) == std::get<2>(b_));
+
+        // swap
+        assign_all(a, b, b, a);
+        REQUIRE(std::get<0>(a) == std::get<0>(b_));
+        REQUIRE(std::get<2>(a) == std::get<2>(b_));
+        REQUIRE(std::get<0>(b) == std::get<0>(a_));
+        REQUIRE(std::get<2>(b) == std::get<2>(a_));
+
+        // plain doubles and valarrays
+        double p = 1.0, q = 2.0;
+        assign_all(p, p + q, q, p - q);
+        REQUIRE(p == 3.0);
+        REQUIRE(q == -1.0);
+
+        std::valarray<double> u = { 1.0, 2.0 }, v = { 3.0, 4.0 };
+        assign_all(u, u + v, v, 2.0 * u);
+        REQUIRE(u[0] == 4.0);
+        REQUIRE(u[1] == 6.0);
+        REQUIRE(v[0] == 2.0);
+        REQUIRE(v[1] == 4.0);
+    }
+
+    SECTION("reductions") {
+
+        std::size_t N = 10001;
+        std::vector<double> x1(N), y1(N), x2(N), y2(N);
+        for (std::size_t i = 0; i != N; i++) {
+            x1[i] = std::sin(i);
+            y1[i] = std::cos(i);
+            x2[i] = 0.5 * std::cos(i);
+            y2[i] = -2.0 * std::sin(i);
+        }
+        auto a = couple(x1, y1, 3.0);
+        auto b = couple(x2, y2, -4.0);
+
+        // expected values, computed by hand
+        double dot_0 = 0, dot_1 = 0, sq_0 = 0, sq_1 = 0, max_0 = 0;
+        for (std::size_t i = 0; i != N; i++) {
+            dot_0 += x1[i] * x2[i];
+            dot_1 += y1[i] * y2[i];
+            sq_0 += (x1[i] - x2[i]) * (x1[i] - x2[i]);
+            sq_1 += (y1[i] - y2[i]) * (y1[i] - y2[i]);
+            max_0 = std::max(max_0, std::fabs(x1[i] - 2 * x2[i]));
+        }
+
+        // the result depends on the order of the operations
+        double tol = 1e-12;
+
+        for (std::size_t nthreads : { 1, 3 }) {
+            set_num_threads(nthreads);
+            set_parallel_threshold(1000);
+
+            REQUIRE(std::fabs(dot(a, b) - (dot_0 + dot_1 - 12.0)) < tol);
+            REQUIRE(std::fabs(dot(a, b, { 1.0, 0.5, 0.0 }) - (dot_0 + 0.5 * dot_1)) < tol);
+            REQUIRE(std::fabs(norm(a - b) - std::sqrt(sq_0 + sq_1 + 49.0)) < tol);
+            REQUIRE(std::fabs(norm(a - b, { 1.0, 0.0, 0.0 }) - std::sqrt(sq_0)) < tol);
+            REQUIRE(max_abs(a - 2 * b) == 11.0);
+            REQUIRE(max_abs(a - 2 * b, { 1.0, 0.0, 0.0 }) == max_0);
+        }
+
+        set_num_threads(1);
+        set_parallel_threshold(1 << 15);
+
+        // a NaN is propagated wherever it is, i.e. in the middle of a block
+        // of lanes, in the tail, or in a component that is not the last
+        for (std::size_t k : { 5, 13, 16 }) {
+            std::vector<double> u(17, 1e-12), v(17, 1e-12);
+            u[k]   = std::nan("");
+            auto c = couple(u, v, 1.0);
+            REQUIRE(std::isnan(max_abs(c)));
+            REQUIRE(std::isnan(max_abs(c, { 1.0, 1.0, 0.0 })));
+
+            // the error norm of a step to a state with a NaN
+            REQUIRE(std::isnan(error_norm(c, c, c, 1e-6, 0.0)));
+            REQUIRE(std::isnan(error_norm(u, u, u, 1e-6, 0.0)));
+        }
+    }
+
     SECTION("copy/reference") {
 
         double q1 = 1.0;
@@ -168,5 +357,66 @@ TEST_CASE("coupled", "tests") {
         REQUIRE(q2 == 6.0);
         REQUIRE(q3 == 13.0);
         REQUIRE(q4 == 14.0);
+
+        // moves take the buffers of the components
+        using vec = std::valarray<double>;
+        auto    d = couple(vec{ 1.0, 2.0, 3.0 }, vec{ 4.0 });
+        double* p = &std::get<0>(d)[0];
+        auto    e = std::move(d);
+        REQUIRE(&std::get<0>(e)[0] == p);
+        REQUIRE(std::get<1>(e)[0] == 4.0);
+        REQUIRE(std::is_nothrow_move_constructible_v<Pair<vec, vec>>);
+
+        // assignment through references assigns the referenced objects
+        vec  u = { 0.0, 0.0, 0.0 };
+        vec  v = { 0.0 };
+        auto f = refcouple(u, v);
+        f      = refcouple(std::get<0>(e), std::get<1>(e));
+        REQUIRE(u[2] == 3.0);
+        REQUIRE(v[0] == 4.0);
+        REQUIRE(&std::get<0>(e)[0] == p);
+    }
+    SECTION("multirate") {
+
+        // a slow component u driving a fast one v, with solution
+        // u = exp(-t), v = C exp(-a t) + a / (a - 1) exp(-t)
+        const double a    = 50;
+        auto         slow = [](double t, const double& u, double& dudt) { dudt = -u; };
+        auto         fast = [a](double t, const double& u, const double& dudt,
+                            const double& v, double& dvdt) { dvdt = -a * (v - u); };
+
+        auto noop = NoOpFunction();
+        auto sys  = System(std::forward_as_tuple(slow, fast),
+            std::forward_as_tuple(noop, noop));
+
+        const double u1 = std::exp(-1.0);
+        const double v1 = -a / (a - 1) * std::exp(-a) + a / (a - 1) * std::exp(-1.0);
+
+        auto z0       = couple(1.0, 0.0);
+        auto stepping = TimeStepConstant(0.1);
+
+        // the macro step is beyond the stability limit of the fast component
+        auto m1   = MultirateRK4<Pair<double, double>>(z0, { 1, 1 });
+        auto phi1 = Flow(sys, m1, stepping);
+        auto z1   = z0;
+        phi1(z1, 0, 1);
+        REQUIRE(std::fabs(std::get<1>(z1) - v1) > 1);
+
+        // but not of the sub-steps, and the slow term is evaluated at the
+        // four stages of each macro step and for the interpolant only
+        auto m2   = MultirateRK4<Pair<double, double>>(z0, { 1, 10 });
+        auto phi2 = Flow(sys, m2, stepping);
+        for (double dt : { 1e-1, 5e-2 }) {
+            stepping.dt = dt;
+            auto z2     = z0;
+            phi2(z2, 0, 1);
+            REQUIRE(std::fabs(std::get<0>(z2) - u1) / std::pow(dt, 4) < 0.004);
+            REQUIRE(std::fabs(std::get<1>(z2) - v1) / std::pow(dt, 4) < 0.005);
+            REQUIRE(m2.nevals[0] == std::size_t(std::round(5 / dt)));
+            REQUIRE(m2.nevals[1] == std::size_t(std::round(40 / dt)));
+        }
+
+        using M = MultirateRK4<Pair<double, double>>;
+        REQUIRE_THROWS_AS(M(z0, { 1, 0 }), std::invalid_argument);
     }
 }
\ No newline at end of file
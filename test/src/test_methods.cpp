@@ -41,6 +41,77 @@ TEST_CASE("methods", "tests") {
         }
     }
 
+    SECTION("CB3R2R adaptive") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ImplicitTerm imTerm(0.5);
+        ExplicitTerm exTerm(0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m1 = CB3R2R_3E(z0);
+        auto m2 = CB3R2R_2(z0);
+
+        // the initial step is far too large, and must be rejected
+        auto stepping = TimeStepAdaptive(1e-6, 0, 1);
+
+        // define integrators
+        auto phi1 = Flow(sys, m1, stepping);
+        auto phi2 = Flow(sys, m2, stepping);
+
+        z0 = 1.0;
+        REQUIRE(std::fabs(phi1(z0, 0, 1) - std::exp(1)) / std::exp(1) < 1e-6);
+        REQUIRE(stepping.nrejected > 0);
+        std::size_t naccepted1 = stepping.naccepted;
+
+        z0 = 1.0;
+        REQUIRE(std::fabs(phi2(z0, 0, 1) - std::exp(1)) / std::exp(1) < 1e-6);
+        REQUIRE(stepping.nrejected > 0);
+
+        // the third order method takes larger steps
+        REQUIRE(naccepted1 < stepping.naccepted);
+
+        // without recording the stages, the error takes a fifth register
+        REQUIRE(m1.storage.size() == 5);
+
+        // with recording, it takes the register of the stage instead
+        auto m3 = CB3R2R_3E(z0);
+        auto m4 = CB3R2R_3E(z0);
+        m3.record_stages(true);
+        z0 = 1.0;
+        REQUIRE(try_step(m3, sys, 0, 0.1, z0, 0, 1e-6) == try_step(m4, sys, 0, 0.1, z0, 0, 1e-6));
+        REQUIRE(m3.storage.size() == 4);
+        REQUIRE(m3._stages.size() == 4);
+    }
+
+    SECTION("CB4R3R") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ImplicitTerm imTerm(0.5);
+        ExplicitTerm exTerm(0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define method
+        auto m = CB4R3R_4(z0);
+        REQUIRE(m.storage.size() == 4);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrator
+        auto phi = Flow(sys, m, stepping);
+
+        for (double dt : { 1e-1, 1e-2 }) {
+            z0          = 1.0;
+            stepping.dt = dt;
+            REQUIRE(std::fabs(phi(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.003);
+        }
+    }
+
     SECTION("CNRK2") {
         // initial condition
         double z0 = 1.0;
@@ -68,6 +139,283 @@ TEST_CASE("methods", "tests") {
         }
     }
 
+    SECTION("ETDRK") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ImplicitTerm imTerm(0.5);
+        ExplicitTerm exTerm(0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m2 = ETDRK2(z0);
+        auto m4 = ETDRK4(z0);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi2 = Flow(sys, m2, stepping);
+        auto phi4 = Flow(sys, m4, stepping);
+
+        for (double dt : { 1e-1, 1e-2 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - std::exp(1)) / std::pow(dt, 2) < 0.06);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi4(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.0015);
+        }
+    }
+
+    SECTION("phi") {
+        // against the Taylor series, near the origin where the
+        // recurrence suffers from cancellation
+        for (double z : { -0.9, -1e-3, 0.0, 1e-8, 0.5, 2.0 }) {
+            for (std::size_t k = 0; k != 4; k++) {
+                double f = 1, term = 1, sum = 0;
+                for (std::size_t j = 1; j <= k; j++)
+                    f *= j;
+                term = 1 / f;
+                for (std::size_t j = 0; j != 40; j++) {
+                    sum += term;
+                    term *= z / (j + k + 1);
+                }
+                REQUIRE(std::fabs(phi(k, z) - sum) / sum < 1e-14);
+            }
+        }
+
+        // coefficients of a diagonal operator
+        auto        table = PhiTable({ -1e4, -1.0, 0.0 });
+        const auto& c     = table(1e-1, 1);
+        REQUIRE(table.size() == 3);
+        REQUIRE(std::fabs(c[0] - (1 - std::exp(-1e3)) / 1e3) < 1e-16);
+        REQUIRE(std::fabs(c[1] - (1 - std::exp(-1e-1)) / 1e-1) < 1e-15);
+        REQUIRE(std::fabs(c[2] - 1.0) < 1e-15);
+        REQUIRE(&table(1e-1, 1) == &c);
+    }
+
+    SECTION("ETDRK stiff") {
+        // initial condition
+        double z0 = 1.0;
+
+        // a stiff linear term is integrated exactly, with steps much
+        // larger than the stability limit of explicit methods
+        ImplicitTerm imTerm(-1e4);
+        ExplicitTerm exTerm(1.0);
+        auto         sys = System(exTerm, imTerm);
+
+        auto m4       = ETDRK4(z0);
+        auto stepping = TimeStepConstant(1e-1);
+        auto phi4     = Flow(sys, m4, stepping);
+
+        REQUIRE(std::fabs(phi4(z0, 0, 1) - std::exp(1 - 1e4)) < 1e-12);
+    }
+
+    SECTION("IMEXMultistep") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ImplicitTerm imTerm(0.5);
+        ExplicitTerm exTerm(0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m1 = IMEXMultistep<CNAB2, double>(z0);
+        auto m2 = IMEXMultistep<SBDF2, double>(z0);
+        auto m3 = IMEXMultistep<SBDF3, double>(z0);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi1 = Flow(sys, m1, stepping);
+        auto phi2 = Flow(sys, m2, stepping);
+        auto phi3 = Flow(sys, m3, stepping);
+
+        for (double dt : { 1e-1, 1e-2, 1e-3 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi1(z0, 0, 1) - std::exp(1)) / std::pow(dt, 2) < 0.46);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - std::exp(1)) / std::pow(dt, 2) < 0.46);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - std::exp(1)) / std::pow(dt, 3) < 0.55);
+        }
+
+        // the time step must be constant
+        stepping.dt = 0.3;
+        z0          = 1.0;
+        REQUIRE_THROWS_AS(phi3(z0, 0, 1), std::invalid_argument);
+    }
+
+    SECTION("RosenbrockW") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system, with solution 1/sqrt(3 e^t - 2)
+        CubicTerm    exTerm(1.0);
+        ImplicitTerm imTerm(-0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m2 = RosenbrockW<ROS2, double>(z0);
+        auto m3 = RosenbrockW<ROS34PW2, double>(z0);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi2 = Flow(sys, m2, stepping);
+        auto phi3 = Flow(sys, m3, stepping);
+
+        const double z1 = 1.0 / std::sqrt(3 * std::exp(1) - 2);
+
+        for (double dt : { 1e-1, 1e-2, 1e-3 }) {
+            stepping.dt = dt;
+            const auto nsteps = static_cast<std::size_t>(std::round(1 / dt));
+
+            // Jacobian at every step
+            m2.max_age = 1;
+            m3.max_age = 1;
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - z1) / std::pow(dt, 2) < 0.5);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - z1) / std::pow(dt, 3) < 0.1);
+            REQUIRE(m3.njacobians == nsteps);
+            REQUIRE(m3.nsolves == 4 * nsteps);
+
+            // Jacobian at the initial condition only, without loss of order
+            m2.max_age = nsteps;
+            m3.max_age = nsteps;
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - z1) / std::pow(dt, 2) < 5.0);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - z1) / std::pow(dt, 3) < 0.25);
+            REQUIRE(m2.njacobians == 1);
+            REQUIRE(m3.njacobians == 1);
+        }
+    }
+
+    SECTION("RosenbrockW stiff") {
+        // initial condition
+        double z0 = 1.0;
+
+        // stiff decay, with solution 1/sqrt(1 + 2 k t)
+        CubicTerm    exTerm(1e3);
+        NoOpFunction imTerm;
+        auto         sys = System(exTerm, imTerm);
+
+        auto m3       = RosenbrockW<ROS34PW2, double>(z0);
+        auto stepping = TimeStepConstant(1e-3);
+        auto phi3     = Flow(sys, m3, stepping);
+
+        const double z1 = 1.0 / std::sqrt(1 + 2e3);
+
+        // the Jacobian is rebuilt when the state changes by more than 10%,
+        // far less often than at every step
+        m3.max_age = 100;
+        m3.rtol    = 0.1;
+        REQUIRE(std::fabs(phi3(z0, 0, 1) - z1) / z1 < 5e-4);
+        REQUIRE(m3.njacobians > 1);
+        REQUIRE(m3.njacobians < 50);
+        REQUIRE(m3.nsolves == 4000);
+    }
+
+    SECTION("DIRK") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ImplicitTerm imTerm(0.5);
+        ExplicitTerm exTerm(0.5);
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods, using the implicit term directly
+        auto m2 = DIRK<CB2, double>(z0);
+        auto m3 = DIRK<CB3e, double>(z0);
+        auto m4 = DIRK<CB4, double>(z0);
+
+        // nonlinear implicit term, with solution 1/sqrt(2 - e^-t)
+        ExplicitTerm      exTermN(0.5);
+        CubicImplicitTerm imTermN(1.0);
+        auto              sysN = System(exTermN, imTermN);
+        auto              n3   = DIRK<CB3e, double, NewtonKrylov<double>>(z0);
+        auto              n4   = DIRK<CB4, double, NewtonKrylov<double>>(z0, 5);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi2  = Flow(sys, m2, stepping);
+        auto phi3  = Flow(sys, m3, stepping);
+        auto phi4  = Flow(sys, m4, stepping);
+        auto phiN3 = Flow(sysN, n3, stepping);
+        auto phiN4 = Flow(sysN, n4, stepping);
+
+        const double z1 = 1.0 / std::sqrt(2 - std::exp(-1));
+
+        for (double dt : { 1e-1, 1e-2 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - std::exp(1)) / std::pow(dt, 2) < 0.07);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - std::exp(1)) / std::pow(dt, 3) < 0.02);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi4(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.003);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phiN3(z0, 0, 1) - z1) / std::pow(dt, 3) < 0.05);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phiN4(z0, 0, 1) - z1) / std::pow(dt, 4) < 0.003);
+        }
+    }
+
+    SECTION("DIRK Newton-Krylov") {
+        // stiff Allen-Cahn equation, with steps ten times larger than
+        // the stability limit of explicit methods
+        const std::size_t   n  = 64;
+        const double        nu = 1.0;
+        const double        h  = 2 * 3.14159265358979323846 / n;
+        std::vector<double> u0(n);
+        for (std::size_t i = 0; i != n; i++)
+            u0[i] = 0.5 * std::sin(i * h) + 0.2 * std::cos(3 * i * h);
+
+        ZeroTerm      exTerm;
+        AllenCahnTerm imTerm(nu, h);
+        auto          sys = System(std::forward_as_tuple(exTerm), std::forward_as_tuple(imTerm));
+        auto          z0  = couple(u0);
+        using Z           = decltype(z0);
+
+        // reference solution
+        auto mref     = DIRK<CB4, Z, NewtonKrylov<Z>>(z0);
+        auto stepping = TimeStepConstant(1e-3);
+        auto phiref   = Flow(sys, mref, stepping);
+        auto zref     = z0;
+        phiref(zref, 0, 1);
+
+        auto m1   = DIRK<CB4, Z, NewtonKrylov<Z>>(z0);
+        auto m2   = DIRK<CB4, Z, NewtonKrylov<Z, AllenCahnPreconditioner>>(z0, 20, AllenCahnPreconditioner(nu, h));
+        auto phi1 = Flow(sys, m1, stepping);
+        auto phi2 = Flow(sys, m2, stepping);
+
+        stepping.dt = 1e-1;
+        auto z1     = z0;
+        auto z2     = z0;
+        phi1(z1, 0, 1);
+        phi2(z2, 0, 1);
+
+        // fourth order, and the preconditioner does not change the solution
+        REQUIRE(norm(z1 - zref) < 3e-5);
+        REQUIRE(norm(z1 - z2) < 1e-9);
+
+        // but it reduces the number of Krylov iterations
+        REQUIRE(m2.solver.nkrylov < m1.solver.nkrylov / 2);
+    }
+
     SECTION("RK4") {
         // initial condition
         double z0 = 1.0;
@@ -94,4 +442,143 @@ TEST_CASE("methods", "tests") {
             REQUIRE(std::fabs(phi(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.023);
         }
     }
-}
\ No newline at end of file
+
+    SECTION("LowStorageRK") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ExplicitTerm exTerm(1.0);
+        NoOpFunction imTerm{};
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m3 = LowStorageRK<Williamson3, double>(z0);
+        auto m4 = LowStorageRK<CarpenterKennedy4, double>(z0);
+        auto m5 = LowStorage2RRK<LowStorage2R5, double>(z0);
+
+        // two registers, whatever the number of stages
+        REQUIRE(m3.storage.size() == 2);
+        REQUIRE(m4.storage.size() == 2);
+        REQUIRE(m5.storage.size() == 2);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi3 = Flow(sys, m3, stepping);
+        auto phi4 = Flow(sys, m4, stepping);
+        auto phi5 = Flow(sys, m5, stepping);
+
+        for (double dt : { 1e-1, 1e-2 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - std::exp(1)) / std::pow(dt, 3) < 0.12);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi4(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.0095);
+        }
+
+        // the fifth order method reaches round-off well before dt = 1e-2
+        for (double dt : { 1e-1, 5e-2 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi5(z0, 0, 1) - std::exp(1)) / std::pow(dt, 5) < 7.5e-5);
+        }
+    }
+
+    SECTION("ExplicitRK") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ExplicitTerm exTerm(1.0);
+        NoOpFunction imTerm{};
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m2 = ExplicitRK<Ralston2, double>(z0);
+        auto m3 = ExplicitRK<SSPRK3, double>(z0);
+        auto m4 = ExplicitRK<Classic4, double>(z0);
+        auto m5 = ExplicitRK<Butcher5, double>(z0);
+
+        // the fifth stage of Butcher5 reuses the register of the second
+        REQUIRE(m5.storage.size() == 6);
+
+        // define time stepping
+        auto stepping = TimeStepConstant(1);
+
+        // define integrators
+        auto phi2 = Flow(sys, m2, stepping);
+        auto phi3 = Flow(sys, m3, stepping);
+        auto phi4 = Flow(sys, m4, stepping);
+        auto phi5 = Flow(sys, m5, stepping);
+
+        for (double dt : { 1e-1, 1e-2 }) {
+            stepping.dt = dt;
+
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi2(z0, 0, 1) - std::exp(1)) / std::pow(dt, 2) < 0.46);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi3(z0, 0, 1) - std::exp(1)) / std::pow(dt, 3) < 0.12);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi4(z0, 0, 1) - std::exp(1)) / std::pow(dt, 4) < 0.023);
+            z0 = 1.0;
+            REQUIRE(std::fabs(phi5(z0, 0, 1) - std::exp(1)) / std::pow(dt, 5) < 0.0005);
+        }
+    }
+
+    SECTION("EmbeddedRK") {
+        // initial condition
+        double z0 = 1.0;
+
+        // define system
+        ExplicitTerm exTerm(1.0);
+        NoOpFunction imTerm{};
+        auto         sys = System(exTerm, imTerm);
+
+        // define methods
+        auto m3 = EmbeddedRK<BS32, double>(z0);
+        auto m5 = EmbeddedRK<DP54, double>(z0);
+
+        // the initial step is far too large, and must be rejected
+        auto stepping = TimeStepAdaptive(1e-8, 0, 1);
+
+        // define integrators
+        auto phi3 = Flow(sys, m3, stepping);
+        auto phi5 = Flow(sys, m5, stepping);
+
+        z0 = 1.0;
+        REQUIRE(std::fabs(phi3(z0, 0, 1) - std::exp(1)) / std::exp(1) < 1e-8);
+        REQUIRE(stepping.nrejected > 0);
+
+        // the last stage is reused as the first stage of the next step
+        // and the first stage is reused when a step is rejected
+        REQUIRE(m3.nevals == 3 * (stepping.naccepted + stepping.nrejected) + 1);
+
+        z0 = 1.0;
+        REQUIRE(std::fabs(phi5(z0, 0, 1) - std::exp(1)) / std::exp(1) < 1e-8);
+        REQUIRE(m5.nevals == 6 * (stepping.naccepted + stepping.nrejected) + 1);
+
+        // integrate backwards
+        z0 = std::exp(1);
+        REQUIRE(std::fabs(phi5(z0, 1, 0) - 1.0) < 1e-8);
+
+        // a NaN error is not retried with ever smaller steps
+        BlowUpTerm blowUp(2.0);
+        auto       sys_nan = System(blowUp, imTerm);
+        auto       phi_nan = Flow(sys_nan, m5, stepping);
+        z0 = 1.0;
+        REQUIRE_THROWS_AS(phi_nan(z0, 0, 1), std::runtime_error);
+        REQUIRE(stepping.nrejected < 100);
+
+        // nor is a step too small to advance the time, here where the
+        // spacing of doubles is 0.125 and the stable steps are smaller
+        ExplicitTerm stiff(-1e3);
+        auto         sys_stiff = System(stiff, imTerm);
+        auto         phi_stiff = Flow(sys_stiff, m5, stepping);
+        z0 = 1.0;
+        REQUIRE_THROWS_AS(phi_stiff(z0, 1e15, 1e15 + 1), std::runtime_error);
+    }
+}
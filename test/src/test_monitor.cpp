@@ -1,4 +1,5 @@
 #include <cmath>
+#include <filesystem>
 #include <iostream>
 
 #include "Flows.hpp"
@@ -41,4 +42,28 @@ TEST_CASE("monitor", "tests") {
         REQUIRE(mon.times()[i] == ts_expected[i]);
         REQUIRE(std::fabs(mon.samples()[i] - std::exp(ts_expected[i])) < 1e-10);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("disk storage", "tests") {
+
+    auto casedir = std::filesystem::temp_directory_path() / "flows_test_storage";
+    std::filesystem::create_directories(casedir);
+
+    // samples are written to disk and read back exactly
+    using vec = std::valarray<double>;
+    auto storage = DiskStorage<Pair<vec, double>>(casedir);
+    for (int i : { 0, 1, 2 })
+        storage.push_back(0.5 * i, couple(vec{ 1.0 * i, 2.0, 1.0 / 3.0 }, std::exp(i)));
+
+    Pair<vec, double> z = couple(vec{}, 0.0);
+    for (int i : { 2, 0, 1 }) {
+        storage.load(i, z);
+        REQUIRE(storage.times()[i] == 0.5 * i);
+        REQUIRE(std::get<0>(z).size() == 3);
+        REQUIRE(std::get<0>(z)[0] == 1.0 * i);
+        REQUIRE(std::get<0>(z)[2] == 1.0 / 3.0);
+        REQUIRE(std::get<1>(z) == std::exp(i));
+    }
+
+    std::filesystem::remove_all(casedir);
+    REQUIRE_THROWS_AS(DiskStorage<double>(casedir), std::invalid_argument);
+}
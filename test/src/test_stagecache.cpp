@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <cmath>
+#include <filesystem>
 #include <iostream>
 #include <valarray>
+#include <utility>
 
 #include "Flows.hpp"
 #include "catch.hpp"
@@ -8,6 +11,46 @@
 
 using namespace Flows;
 
+// a RAM stage cache counting the stages it copies
+template <typename X, std::size_t N>
+struct CountingStageCache : public RAMStageCache<X, N> {
+    static constexpr std::size_t nstages = N;
+    std::size_t                  ncopies = 0;
+
+    void push_back(const X& x) override {
+        ncopies++;
+        RAMStageCache<X, N>::push_back(x);
+    }
+};
+
+// the Lorenz system counting the evaluations of its explicit term
+struct CountingLorenz : public Lorenz {
+    std::size_t nevals = 0;
+
+    CountingLorenz()
+        : Lorenz(1) {}
+
+    void operator()(double t, const vec3& u, vec3& dudt) {
+        nevals++;
+        Lorenz::operator()(t, u, dudt);
+    }
+};
+
+// the Lorenz system evaluated into scratch space, which must not be
+// shared by systems called concurrently
+struct ScratchLorenz : public Lorenz {
+    vec3 _tmp;
+
+    ScratchLorenz()
+        : Lorenz(1)
+        , _tmp(3) {}
+
+    void operator()(double t, const vec3& u, vec3& dudt) {
+        Lorenz::operator()(t, u, _tmp);
+        dudt = _tmp;
+    }
+};
+
 TEST_CASE("stagecache", "tests") {
 
     SECTION("rk4") {
@@ -129,5 +172,983 @@ TEST_CASE("stagecache", "tests") {
         auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
 
         REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+
+        /* ADAPTIVE STEPS */
+        // the stages of the accepted attempts are pushed to the cache, without
+        // evaluating the system again, and are those of the fixed step method
+        auto l        = CountingLorenz();
+        auto sys_l    = System(l, l);
+        auto ma       = CB3R2R_3E<vec3, false>(x);
+        auto stepping = TimeStepAdaptive(1e-6, 1e-6, 1e-2);
+        auto phi      = Flow(sys_l, ma, stepping);
+        vec3 xa       = { 15.0, 16.0, 20.0 };
+        phi(xa, 0.0, 0.5);
+        std::size_t nevals = l.nevals;
+
+        auto cache_a = RAMStageCache<vec3, 4>();
+        vec3 xb      = { 15.0, 16.0, 20.0 };
+        l.nevals     = 0;
+        phi(xb, 0.0, 0.5, cache_a);
+        REQUIRE(l.nevals == nevals);
+        REQUIRE((xa == xb).min());
+        REQUIRE(cache_a.size() == stepping.naccepted);
+
+        auto cache_r = RAMStageCache<vec3, 4>();
+        vec3 xr      = { 15.0, 16.0, 20.0 };
+        for (auto [t, dt, stages] : cache_a)
+            step(mx, sys_x, t, dt, xr, cache_r);
+        bool same = (xr == xb).min();
+        for (std::size_t i = 0; i != cache_a.size(); i++)
+            for (std::size_t k = 0; k != 4; k++)
+                same = same && (std::get<2>(cache_a[i])[k] == std::get<2>(cache_r[i])[k]).min();
+        REQUIRE(same);
+    }
+
+    SECTION("CB4R3R") {
+
+        /* DEFINE NONLINEAR OBJECT TO FILL THE STAGE CACHE */
+        // initial condition
+        vec3 x = { 15.0, 16.0, 20.0 };
+
+        // define nonlinear forward method
+        auto mx = CB4R3R_4<vec3, false>(x);
+
+        // construct system
+        auto a     = Lorenz(1);
+        auto sys_x = System(a, a);
+
+        // define cache
+        auto cache = RAMStageCache<vec3, 6>();
+
+        // call object and fill cache for one step
+        step(mx, sys_x, 0.0, 1e-2, x, cache);
+
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        vec3 y = { 1.0, 2.0, 3.0 };
+        x      = { 15.0, 16.0, 20.0 }; // reset state
+
+        auto z_copy = couple(x, y);
+        auto z_ref  = refcouple(x, y);
+
+        // define linearised forward method
+        auto mz = CB4R3R_4<Pair<vec3, vec3>, false>(z_copy);
+
+        // construct system
+        auto a_tan = LorenzTan(1);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(a, a_tan));
+
+        // call object
+        step(mz, sys_z, 0.0, 0.01, z_ref, NoOpStageCache<Pair<vec3, vec3>>());
+
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised forward method
+        auto mw = CB4R3R_4<vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(1);
+        auto sys_w = System(a_adj, a_adj);
+
+        // get stages from the cache
+        auto [t, dt, stages] = cache[0];
+
+        // call object
+        step(mw, sys_w, 0.0, 0.01, w, stages);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+    }
+
+    SECTION("ExplicitRK") {
+
+        /* DEFINE NONLINEAR OBJECT TO FILL THE STAGE CACHE */
+        // initial condition
+        vec3 x = { 1.0, 1.0, 2.0 };
+
+        // define nonlinear forward method
+        auto mx = ExplicitRK<Butcher5, vec3, false>(x);
+
+        // construct system
+        auto a     = Lorenz(0.0);
+        auto noop  = NoOpFunction();
+        auto sys_x = System(a, noop);
+
+        // define cache
+        auto cache = RAMStageCache<vec3, 6>();
+
+        // call object and fill cache for one step
+        step(mx, sys_x, 0.0, 1e-2, x, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        vec3 y = { 1.0, 2.0, 3.0 };
+        x      = { 1.0, 1.0, 2.0 }; // reset state
+
+        auto z_copy = couple(x, y);
+        auto z_ref  = refcouple(x, y);
+
+        // define linearised forward method
+        auto mz = ExplicitRK<Butcher5, Pair<vec3, vec3>, false>(z_copy);
+
+        // construct system
+        auto a_tan = LorenzTan(0.0);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(noop, noop));
+
+        // call object
+        step(mz, sys_z, 0.0, 0.01, z_ref, NoOpStageCache<Pair<vec3, vec3>>());
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised forward method
+        auto mw = ExplicitRK<Butcher5, vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(0.0);
+        auto sys_w = System(a_adj, noop);
+
+        // get stages from the cache
+        auto [t, dt, stages] = cache[0];
+
+        // call object
+        step(mw, sys_w, 0.0, 0.01, w, stages);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+    }
+
+    SECTION("CNRK2") {
+
+        /* FILL THE STAGE CACHE OVER SEVERAL STEPS */
+        // initial condition
+        vec3 x = { 15.0, 16.0, 20.0 };
+
+        // define nonlinear forward method
+        auto mx = CNRK2<vec3, false>(x);
+
+        // construct system
+        auto a     = Lorenz(1);
+        auto sys_x = System(a, a);
+
+        // define cache and integrator
+        auto stepping = TimeStepConstant(1e-2);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto cache    = RAMStageCache<vec3, 2>();
+        phi_x(x, 0.0, 0.5, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        // the forward method passes the state to the system, so
+        // the coupled state must be of the same type as the storage
+        auto z = couple(vec3{ 15.0, 16.0, 20.0 }, vec3{ 1.0, 2.0, 3.0 });
+
+        // define linearised forward method
+        auto mz = CNRK2<Pair<vec3, vec3>, false>(z);
+
+        // construct system
+        auto a_tan = LorenzTan(1);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(a, a_tan));
+
+        // call object
+        auto phi_z = Flow(sys_z, mz, stepping);
+        phi_z(z, 0.0, 0.5);
+        vec3 y = std::get<1>(z);
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised adjoint method
+        auto mw = CNRK2<vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(1);
+        auto sys_w = System(a_adj, a_adj);
+
+        // integrate backwards over the stages in the cache
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, cache);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-13);
+    }
+
+    SECTION("ETDRK4") {
+
+        /* FILL THE STAGE CACHE OVER SEVERAL STEPS */
+        // initial condition
+        vec3 x = { 15.0, 16.0, 20.0 };
+
+        // define nonlinear forward method
+        auto mx = ETDRK4<vec3, false>(x);
+
+        // construct system, the linear term is integrated exactly
+        auto a     = Lorenz(1);
+        auto sys_x = System(a, a);
+
+        // define cache and integrator
+        auto stepping = TimeStepConstant(1e-2);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto cache    = RAMStageCache<vec3, 4>();
+        phi_x(x, 0.0, 0.5, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        auto z = couple(vec3{ 15.0, 16.0, 20.0 }, vec3{ 1.0, 2.0, 3.0 });
+
+        // define linearised forward method
+        auto mz = ETDRK4<Pair<vec3, vec3>, false>(z);
+
+        // construct system
+        auto a_tan = LorenzTan(1);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(a, a_tan));
+
+        // call object
+        auto phi_z = Flow(sys_z, mz, stepping);
+        phi_z(z, 0.0, 0.5);
+        vec3 y = std::get<1>(z);
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised adjoint method
+        auto mw = ETDRK4<vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(1);
+        auto sys_w = System(a_adj, a_adj);
+
+        // integrate backwards over the stages in the cache
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, cache);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-13);
+    }
+
+    SECTION("ETDRK2") {
+
+        /* FILL THE STAGE CACHE FOR ONE STEP */
+        vec3 x     = { 15.0, 16.0, 20.0 };
+        auto mx    = ETDRK2<vec3, false>(x);
+        auto a     = Lorenz(1);
+        auto sys_x = System(a, a);
+        auto cache = RAMStageCache<vec3, 2>();
+        step(mx, sys_x, 0.0, 1e-2, x, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        auto z     = couple(vec3{ 15.0, 16.0, 20.0 }, vec3{ 1.0, 2.0, 3.0 });
+        auto mz    = ETDRK2<Pair<vec3, vec3>, false>(z);
+        auto a_tan = LorenzTan(1);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(a, a_tan));
+        step(mz, sys_z, 0.0, 1e-2, z, NoOpStageCache<Pair<vec3, vec3>>());
+        vec3 y = std::get<1>(z);
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w     = { 4.0, 5.0, 7.0 };
+        auto mw    = ETDRK2<vec3, true>(w);
+        auto a_adj = LorenzAdj(1);
+        auto sys_w = System(a_adj, a_adj);
+        auto [t, dt, stages] = cache[0];
+        step(mw, sys_w, 0.0, 1e-2, w, stages);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+    }
+
+    SECTION("IMEXMultistep") {
+
+        // check the adjoint of a method over several steps, including startup
+        auto check = [](auto mx, auto mz, auto mw) {
+            /* FILL THE STAGE CACHE */
+            vec3 x     = { 15.0, 16.0, 20.0 };
+            auto a     = Lorenz(1);
+            auto sys_x = System(a, a);
+
+            auto stepping = TimeStepConstant(1e-2);
+            auto phi_x    = Flow(sys_x, mx, stepping);
+            auto cache    = RAMStageCache<vec3, 1>();
+            phi_x(x, 0.0, 0.5, cache);
+
+            /* DEFINE FORWARD LINEAR PROBLEM */
+            auto z     = couple(vec3{ 15.0, 16.0, 20.0 }, vec3{ 1.0, 2.0, 3.0 });
+            auto a_tan = LorenzTan(1);
+            auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(a, a_tan));
+            auto phi_z = Flow(sys_z, mz, stepping);
+            phi_z(z, 0.0, 0.5);
+            vec3 y = std::get<1>(z);
+
+            /* DEFINE ADJOINT LINEAR PROBLEM */
+            vec3 w          = { 4.0, 5.0, 7.0 };
+            auto a_adj      = LorenzAdj(1);
+            auto sys_w      = System(a_adj, a_adj);
+            auto stepping_w = TimeStepFromStageCache();
+            auto phi_w      = Flow(sys_w, mw, stepping_w);
+            phi_w(w, cache);
+
+            // calculate dot products
+            auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+            auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+            REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-13);
+        };
+
+        vec3 x = { 0.0, 0.0, 0.0 };
+        auto z = couple(x, x);
+        check(IMEXMultistep<CNAB2, vec3, false>(x),
+              IMEXMultistep<CNAB2, Pair<vec3, vec3>, false>(z),
+              IMEXMultistep<CNAB2, vec3, true>(x));
+        check(IMEXMultistep<SBDF3, vec3, false>(x),
+              IMEXMultistep<SBDF3, Pair<vec3, vec3>, false>(z),
+              IMEXMultistep<SBDF3, vec3, true>(x));
+    }
+
+    SECTION("LowStorageRK") {
+
+        /* DEFINE NONLINEAR OBJECT TO FILL THE STAGE CACHE */
+        // initial condition
+        vec3 x = { 1.0, 1.0, 2.0 };
+
+        // define nonlinear forward method
+        auto mx = LowStorageRK<CarpenterKennedy4, vec3, false>(x);
+
+        // construct system
+        auto a     = Lorenz(0.0);
+        auto noop  = NoOpFunction();
+        auto sys_x = System(a, noop);
+
+        // define cache
+        auto cache = RAMStageCache<vec3, 5>();
+
+        // call object and fill cache for one step
+        step(mx, sys_x, 0.0, 1e-2, x, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        vec3 y = { 1.0, 2.0, 3.0 };
+        x      = { 1.0, 1.0, 2.0 }; // reset state
+
+        auto z_copy = couple(x, y);
+        auto z_ref  = refcouple(x, y);
+
+        // define linearised forward method
+        auto mz = LowStorageRK<CarpenterKennedy4, Pair<vec3, vec3>, false>(z_copy);
+
+        // construct system
+        auto a_tan = LorenzTan(0.0);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(noop, noop));
+
+        // call object
+        step(mz, sys_z, 0.0, 0.01, z_ref, NoOpStageCache<Pair<vec3, vec3>>());
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised forward method
+        auto mw = LowStorageRK<CarpenterKennedy4, vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(0.0);
+        auto sys_w = System(a_adj, noop);
+
+        // get stages from the cache
+        auto [t, dt, stages] = cache[0];
+
+        // call object
+        step(mw, sys_w, 0.0, 0.01, w, stages);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+    }
+
+    SECTION("LowStorage2RRK") {
+
+        /* DEFINE NONLINEAR OBJECT TO FILL THE STAGE CACHE */
+        // initial condition
+        vec3 x = { 1.0, 1.0, 2.0 };
+
+        // define nonlinear forward method
+        auto mx = LowStorage2RRK<LowStorage2R5, vec3, false>(x);
+
+        // construct system
+        auto a     = Lorenz(0.0);
+        auto noop  = NoOpFunction();
+        auto sys_x = System(a, noop);
+
+        // define cache
+        auto cache = RAMStageCache<vec3, 9>();
+
+        // call object and fill cache for one step
+        step(mx, sys_x, 0.0, 1e-2, x, cache);
+
+        /* DEFINE FORWARD LINEAR PROBLEM */
+        vec3 y = { 1.0, 2.0, 3.0 };
+        x      = { 1.0, 1.0, 2.0 }; // reset state
+
+        auto z_copy = couple(x, y);
+        auto z_ref  = refcouple(x, y);
+
+        // define linearised forward method
+        auto mz = LowStorage2RRK<LowStorage2R5, Pair<vec3, vec3>, false>(z_copy);
+
+        // construct system
+        auto a_tan = LorenzTan(0.0);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(noop, noop));
+
+        // call object
+        step(mz, sys_z, 0.0, 0.01, z_ref, NoOpStageCache<Pair<vec3, vec3>>());
+
+        /* DEFINE ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        // define linearised forward method
+        auto mw = LowStorage2RRK<LowStorage2R5, vec3, true>(w);
+
+        // construct system
+        auto a_adj = LorenzAdj(0.0);
+        auto sys_w = System(a_adj, noop);
+
+        // get stages from the cache
+        auto [t, dt, stages] = cache[0];
+
+        // call object
+        step(mw, sys_w, 0.0, 0.01, w, stages);
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-14);
+    }
+
+    SECTION("EmbeddedRK") {
+
+        /* FILL THE STAGE CACHE WITH THE ACCEPTED STEPS */
+        vec3 x = { 1.0, 1.0, 2.0 };
+
+        auto a     = Lorenz(0.0);
+        auto noop  = NoOpFunction();
+        auto sys_x = System(a, noop);
+
+        auto mx       = EmbeddedRK<DP54, vec3, false>(x);
+        auto stepping = TimeStepAdaptive(1e-6, 1e-6, 1e-3);
+        auto phi      = Flow(sys_x, mx, stepping);
+        auto cache    = RAMStageCache<vec3, 7>();
+        phi(x, 0.0, 0.5, cache);
+        REQUIRE(stepping.naccepted > 10);
+
+        /* FORWARD LINEAR PROBLEM OVER THE SAME STEPS */
+        vec3 y = { 1.0, 2.0, 3.0 };
+        x      = { 1.0, 1.0, 2.0 }; // reset state
+
+        auto z_copy = couple(x, y);
+        auto z_ref  = refcouple(x, y);
+
+        auto mz    = ExplicitRK<DP54, Pair<vec3, vec3>, false>(z_copy);
+        auto a_tan = LorenzTan(0.0);
+        auto sys_z = System(std::forward_as_tuple(a, a_tan), std::forward_as_tuple(noop, noop));
+
+        std::size_t nsteps = 0;
+        for (auto [t, dt, stages] : cache) {
+            step(mz, sys_z, t, dt, z_ref, NoOpStageCache<Pair<vec3, vec3>>());
+            nsteps++;
+        }
+        REQUIRE(nsteps == stepping.naccepted);
+        REQUIRE(std::fabs(std::get<1>(cache[nsteps - 1]) + std::get<0>(cache[nsteps - 1]) - 0.5) < 1e-15);
+
+        /* ADJOINT LINEAR PROBLEM */
+        vec3 w = { 4.0, 5.0, 7.0 };
+
+        auto mw    = EmbeddedRK<DP54, vec3, true>(w);
+        auto a_adj = LorenzAdj(0.0);
+        auto sys_w = System(a_adj, noop);
+
+        for (std::size_t i = nsteps; i != 0; i--) {
+            auto [t, dt, stages] = cache[i - 1];
+            step(mw, sys_w, t, dt, w, stages);
+        }
+
+        // calculate dot products
+        auto p_1 = y[0] * 4.0 + y[1] * 5.0 + y[2] * 7.0;
+        auto p_2 = w[0] * 1.0 + w[1] * 2.0 + w[2] * 3.0;
+
+        REQUIRE(std::fabs(p_1 - p_2) / std::fabs(p_1) < 1e-13);
+    }
+
+    SECTION("Revolve") {
+
+        /* ADJOINT OVER THE FULL STAGE CACHE */
+        auto a        = Lorenz(1);
+        auto sys_x    = System(a, a);
+        vec3 x0       = { 15.0, 16.0, 20.0 };
+        auto mx       = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto cache    = RAMStageCache<vec3, 4>();
+        vec3 x        = x0;
+        phi_x(x, 0.0, 0.5, cache);
+
+        auto a_adj      = LorenzAdj(1);
+        auto sys_w      = System(a_adj, a_adj);
+        vec3 w          = { 4.0, 5.0, 7.0 };
+        auto mw         = RK4<vec3, true>(w);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, cache);
+
+        /* CHECKPOINTED ADJOINT */
+        // the forward steps are recomputed exactly, and their number is
+        // 100 recorded steps plus t n - (S + t, t - 1) to place snapshots,
+        // with t = 13 for S = 2, t = 4 for S = 5 and t = 1 for S >= n
+        for (auto [S, nforward] : { std::pair{ 1, 5050 }, { 2, 945 }, { 5, 416 }, { 200, 199 } }) {
+            auto rev = Revolve(sys_x, mx, sys_w, mw, stepping, S);
+            vec3 xr  = x0;
+            vec3 l   = { 0.0, 0.0, 0.0 };
+            rev(xr, l, 0.0, 0.5, [](const vec3& xT, vec3& lT) { lT = { 4.0, 5.0, 7.0 }; });
+
+            REQUIRE((xr == x).min());
+            REQUIRE((l == w).min());
+            REQUIRE(rev.nsteps == 100);
+            REQUIRE(rev.nforward == std::size_t(nforward));
+            REQUIRE(rev.recomputation_factor() == nforward / 100.0);
+        }
+
+        /* TWO LEVEL CHECKPOINTS */
+        // the first snapshots are spilled to disk, without changing the
+        // schedule, and the snapshot needed after each segment is read
+        // while the segment is reversed
+        auto casedir = std::filesystem::temp_directory_path() / "flows_test_revolve";
+        std::filesystem::create_directories(casedir);
+        for (std::size_t R : { 0, 2, 4 }) {
+            auto rev = Revolve(sys_x, mx, sys_w, mw, stepping, 5, R, casedir);
+            vec3 xr  = x0;
+            vec3 l   = { 0.0, 0.0, 0.0 };
+            rev(xr, l, 0.0, 0.5, [](const vec3& xT, vec3& lT) { lT = { 4.0, 5.0, 7.0 }; });
+
+            REQUIRE((xr == x).min());
+            REQUIRE((l == w).min());
+            REQUIRE(rev.nforward == 416);
+            REQUIRE(rev.ndisk_writes > 0);
+            REQUIRE(rev.ndisk_misses == 0);
+        }
+        REQUIRE(std::filesystem::is_empty(casedir));
+        std::filesystem::remove(casedir);
+
+        REQUIRE_THROWS_AS(Revolve(sys_x, mx, sys_w, mw, stepping, 5, 2), std::invalid_argument);
+    }
+
+    SECTION("PipelinedAdjoint") {
+
+        // the segments recomputed by the workers, with systems of their
+        // own, give the same adjoint as the full stage cache, and each step
+        // but those of the last segment is made twice
+        auto a        = ScratchLorenz();
+        auto sys_x    = System(a, a);
+        vec3 x0       = { 15.0, 16.0, 20.0 };
+        auto mx       = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto cache    = RAMStageCache<vec3, 4>();
+        vec3 x        = x0;
+        phi_x(x, 0.0, 0.5, cache);
+
+        auto a_adj      = LorenzAdj(1);
+        auto sys_w      = System(a_adj, a_adj);
+        vec3 w          = { 4.0, 5.0, 7.0 };
+        auto mw         = RK4<vec3, true>(w);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, cache);
+
+        std::size_t nsystems    = 0;
+        auto        make_system = [&nsystems] {
+            nsystems++;
+            return System(ScratchLorenz(), ScratchLorenz());
+        };
+
+        for (auto [K, nforward] : { std::pair{ 1, 199 }, { 7, 198 }, { 100, 100 }, { 1000, 100 } }) {
+            for (std::size_t P : { 1, 3 }) {
+                nsystems = 0;
+                auto adj = PipelinedAdjoint(sys_x, mx, sys_w, mw, stepping, K, P, make_system);
+                vec3 xp  = x0;
+                vec3 l   = { 0.0, 0.0, 0.0 };
+                adj(xp, l, 0.0, 0.5, [](const vec3& xT, vec3& lT) { lT = { 4.0, 5.0, 7.0 }; });
+
+                REQUIRE((xp == x).min());
+                REQUIRE((l == w).min());
+                REQUIRE(adj.nsteps == 100);
+                REQUIRE(adj.nforward == std::size_t(nforward));
+                REQUIRE(nsystems == (K >= 100 ? 0 : P));
+            }
+        }
+
+        REQUIRE_THROWS_AS(PipelinedAdjoint(sys_x, mx, sys_w, mw, stepping, 0, 1, make_system), std::invalid_argument);
+        REQUIRE_THROWS_AS(PipelinedAdjoint(sys_x, mx, sys_w, mw, stepping, 1, 0, make_system), std::invalid_argument);
+    }
+
+    SECTION("MmapStageCache") {
+
+        /* ADJOINT OVER THE RAM STAGE CACHE */
+        auto a        = Lorenz(1);
+        auto sys_x    = System(a, a);
+        vec3 x0       = { 15.0, 16.0, 20.0 };
+        auto mx       = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto ram      = RAMStageCache<vec3, 4>();
+        vec3 x        = x0;
+        phi_x(x, 0.0, 0.5, ram);
+
+        auto a_adj      = LorenzAdj(1);
+        auto sys_w      = System(a_adj, a_adj);
+        vec3 w          = { 4.0, 5.0, 7.0 };
+        auto mw         = RK4<vec3, true>(w);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, ram);
+
+        /* ADJOINT OVER THE MAPPED FILE */
+        // the initial size is small, so that the mapping grows
+        auto filename = std::filesystem::temp_directory_path() / "flows_test_mmap.stages";
+        {
+            auto cache = MmapStageCache<vec3, 4>(filename, MmapMode::Create, 64);
+            vec3 xm    = x0;
+            phi_x(xm, 0.0, 0.5, cache);
+            REQUIRE((xm == x).min());
+
+            vec3 wm = { 4.0, 5.0, 7.0 };
+            phi_w(wm, cache);
+            REQUIRE((wm == w).min());
+        }
+
+        // the file can be read by other caches, e.g. in other processes
+        for (int i = 0; i != 2; i++) {
+            auto cache = MmapStageCache<vec3, 4>(filename, MmapMode::ReadOnly);
+            vec3 wm    = { 4.0, 5.0, 7.0 };
+            phi_w(wm, cache);
+            REQUIRE((wm == w).min());
+            REQUIRE_THROWS_AS(cache.push_back(x), std::logic_error);
+        }
+        std::filesystem::remove(filename);
+
+        /* COUPLED AND TRIVIALLY COPYABLE TYPES */
+        // coupled stages are decoded, and scalars are read in place
+        {
+            auto cache = MmapStageCache<Pair<vec3, double>, 2>(filename);
+            cache.setup_step(0.0, 0.1);
+            cache.push_back(couple(vec3{ 1.0, 2.0, 3.0 }, 4.0));
+            cache.push_back(couple(vec3{ 5.0, 6.0 }, 7.0));
+            cache.close_step();
+
+            auto [t, dt, stages] = cache[0];
+            REQUIRE(t == 0.0);
+            REQUIRE(dt == 0.1);
+            REQUIRE(std::get<0>(stages[1]).size() == 2);
+            REQUIRE(std::get<0>(stages[1])[1] == 6.0);
+            REQUIRE(std::get<1>(stages[1]) == 7.0);
+            REQUIRE(std::get<0>(stages[0]).size() == 3);
+            REQUIRE(std::get<0>(stages[0])[2] == 3.0);
+            REQUIRE(std::get<1>(stages[0]) == 4.0);
+        }
+        {
+            auto cache = MmapStageCache<double, 1>(filename);
+            for (int i = 0; i != 3; i++) {
+                cache.setup_step(i, 1.0);
+                cache.push_back(0.5 * i);
+                cache.close_step();
+            }
+            auto [t, dt, stages] = cache[2];
+            REQUIRE(stages[0] == 1.0);
+
+            // a step takes 32 bytes, for the time, the step and the stage
+            REQUIRE(&std::get<2>(cache[1])[0] == &stages[0] - 4);
+        }
+        std::filesystem::remove(filename);
+    }
+
+    SECTION("CompressedStageCache") {
+
+        /* ADJOINT OVER THE RAM STAGE CACHE */
+        auto a        = Lorenz(1);
+        auto sys_x    = System(a, a);
+        vec3 x0       = { 15.0, 16.0, 20.0 };
+        auto mx       = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+        auto ram      = RAMStageCache<vec3, 4>();
+        vec3 x        = x0;
+        phi_x(x, 0.0, 0.5, ram);
+
+        auto a_adj      = LorenzAdj(1);
+        auto sys_w      = System(a_adj, a_adj);
+        vec3 w          = { 4.0, 5.0, 7.0 };
+        auto mw         = RK4<vec3, true>(w);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+        phi_w(w, ram);
+
+        // adjoint over a compressed cache, and its relative error
+        auto adjoint_error = [&](auto& cache) {
+            vec3 xc = x0;
+            phi_x(xc, 0.0, 0.5, cache);
+            vec3 wc = { 4.0, 5.0, 7.0 };
+            phi_w(wc, cache);
+            REQUIRE(cache.decode_throughput() > 0);
+            return std::abs(wc - w).max() / std::abs(w).max();
+        };
+
+        /* LOSSY AND LOSSLESS CODECS */
+        auto c_float = CompressedStageCache<vec3, 4, FloatCodec>();
+        REQUIRE(adjoint_error(c_float) < 1e-7);
+        REQUIRE(c_float.compression_ratio() == 2);
+
+        auto c_lz = CompressedStageCache<vec3, 4, ShuffleLZCodec>();
+        REQUIRE(adjoint_error(c_lz) == 0);
+
+        auto c_quant = CompressedStageCache<vec3, 4, QuantizerCodec>(1e-6);
+        REQUIRE(adjoint_error(c_quant) < 1e-7);
+        REQUIRE(c_quant.compression_ratio() > 2);
+
+        /* CODECS OVER A SMOOTH FIELD */
+        // with a zero region and a smooth one, where runs of leading bytes
+        // and small differences of consecutive values compress well
+        std::vector<double> f(4096), g(4096);
+        for (std::size_t i = 0; i != f.size(); i++)
+            f[i] = i < 2048 ? 0.0 : std::sin(0.01 * i);
+
+        std::vector<std::uint8_t> out;
+        ShuffleLZCodec            lz;
+        lz.encode(f.data(), f.size(), out);
+        REQUIRE(lz.decode(out.data(), g.data(), g.size()) == out.data() + out.size());
+        REQUIRE(f == g);
+        REQUIRE(out.size() < f.size() * sizeof(double) / 2);
+
+        out.clear();
+        QuantizerCodec quant(1e-6);
+        quant.encode(f.data(), f.size(), out);
+        REQUIRE(quant.decode(out.data(), g.data(), g.size()) == out.data() + out.size());
+        double err = 0;
+        for (std::size_t i = 0; i != f.size(); i++)
+            err = std::max(err, std::fabs(f[i] - g[i]));
+        REQUIRE(err <= 1e-6);
+        REQUIRE(out.size() < f.size() * sizeof(double) / 4);
+
+        /* COUPLED STAGES */
+        auto cache = CompressedStageCache<Pair<vec3, double>, 2, ShuffleLZCodec>();
+        cache.setup_step(0.0, 0.1);
+        cache.push_back(couple(vec3{ 1.0, 2.0, 3.0 }, 4.0));
+        cache.push_back(couple(vec3{ 5.0, 6.0, 7.0 }, 8.0));
+        cache.close_step();
+        auto [t, dt, stages] = cache[0];
+        REQUIRE(std::get<0>(stages[1])[2] == 7.0);
+        REQUIRE(std::get<1>(stages[1]) == 8.0);
+        REQUIRE(std::get<0>(stages[0])[0] == 1.0);
+        REQUIRE(std::get<1>(stages[0]) == 4.0);
+    }
+
+    SECTION("RAMStageCache reuse") {
+
+        auto a        = Lorenz(1);
+        auto sys_x    = System(a, a);
+        vec3 x0       = { 15.0, 16.0, 20.0 };
+        auto mx       = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi_x    = Flow(sys_x, mx, stepping);
+
+        auto a_adj      = LorenzAdj(1);
+        auto sys_w      = System(a_adj, a_adj);
+        auto mw         = RK4<vec3, true>(x0);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w      = Flow(sys_w, mw, stepping_w);
+
+        // the slots are reserved for the horizon, then reused in place
+        auto cache = RAMStageCache<vec3, 4>();
+        cache.reserve(TimeRange(0.0, 0.5, 0.005));
+
+        const double* slot = nullptr;
+        vec3          w_first;
+        for (int iter = 0; iter != 3; iter++) {
+            cache.reset();
+            vec3 x = x0;
+            phi_x(x, 0.0, 0.5, cache);
+            REQUIRE(cache.size() == 100);
+
+            vec3 w = { 4.0, 5.0, 7.0 };
+            phi_w(w, cache);
+
+            auto [t, dt, stages] = cache[99];
+            if (iter == 0) {
+                slot    = &stages[3][0];
+                w_first = w;
+            }
+            REQUIRE(&stages[3][0] == slot);
+            REQUIRE((w == w_first).min());
+        }
+    }
+
+    SECTION("next_slot") {
+
+        // the stages written in place are those pushed to a cache without
+        // slots, and only the first stage ever is copied. When the cache
+        // is reused, no stage is copied
+        auto check = [](auto m, auto cache) {
+            constexpr std::size_t N = decltype(cache)::nstages;
+
+            auto a        = Lorenz(1);
+            auto sys      = System(a, a);
+            vec3 x0       = { 15.0, 16.0, 20.0 };
+            auto stepping = TimeStepConstant(0.005);
+            auto phi      = Flow(sys, m, stepping);
+            auto ref      = CompressedStageCache<vec3, N, ShuffleLZCodec>();
+            vec3 x        = x0;
+            phi(x, 0.0, 0.5, ref);
+
+            for (std::size_t ncopies : { 1, 0 }) {
+                cache.reset();
+                cache.ncopies = 0;
+                vec3 xc       = x0;
+                phi(xc, 0.0, 0.5, cache);
+                REQUIRE(cache.ncopies == ncopies);
+                REQUIRE((xc == x).min());
+                bool same = cache.size() == 100;
+                for (std::size_t i = 0; i != cache.size(); i++)
+                    for (std::size_t k = 0; k != N; k++)
+                        same = same && (std::get<2>(cache[i])[k] == std::get<2>(ref[i])[k]).min();
+                REQUIRE(same);
+            }
+        };
+
+        vec3 x0 = { 15.0, 16.0, 20.0 };
+        check(RK4<vec3, false>(x0), CountingStageCache<vec3, 4>());
+        check(CB3R2R_3E<vec3, false>(x0), CountingStageCache<vec3, 4>());
+        check(CB4R3R_4<vec3, false>(x0), CountingStageCache<vec3, 6>());
+    }
+
+    SECTION("local recomputation") {
+
+        // only the state at the beginning of each step is stored, and the
+        // adjoint is the same as with the stored stages
+        auto check = [](auto mx, auto mw, auto stepping, auto nstages) {
+            constexpr std::size_t N = decltype(nstages)::value;
+
+            auto a          = Lorenz(1);
+            auto sys_x      = System(a, a);
+            auto a_adj      = LorenzAdj(1);
+            auto sys_w      = System(a_adj, a_adj);
+            auto stepping_w = TimeStepFromStageCache();
+            auto phi_w      = Flow(sys_w, mw, stepping_w);
+
+            vec3 x[2], w[2];
+            for (bool on : { false, true }) {
+                auto st    = stepping;
+                auto phi_x = Flow(sys_x, mx, st);
+                auto cache = RAMStageCache<vec3, N>();
+                phi_x.set_local_recomputation(on);
+                x[on] = { 15.0, 16.0, 20.0 };
+                phi_x(x[on], 0.0, 0.5, cache);
+                REQUIRE(cache.size() > 10);
+                REQUIRE(cache.stored() == (on ? 1 : N) * cache.size());
+                w[on] = { 4.0, 5.0, 7.0 };
+                phi_w(w[on], cache);
+            }
+            REQUIRE((x[0] == x[1]).min());
+            REQUIRE((w[0] == w[1]).min());
+        };
+
+        vec3 x0 = { 15.0, 16.0, 20.0 };
+        check(RK4<vec3, false>(x0), RK4<vec3, true>(x0),
+            TimeStepConstant(0.005), std::integral_constant<std::size_t, 4>());
+        check(CB3R2R_3E<vec3, false>(x0), CB3R2R_3E<vec3, true>(x0),
+            TimeStepConstant(0.005), std::integral_constant<std::size_t, 4>());
+        check(EmbeddedRK<DP54, vec3, false>(x0), EmbeddedRK<DP54, vec3, true>(x0),
+            TimeStepAdaptive(1e-6, 1e-6, 1e-3), std::integral_constant<std::size_t, 7>());
+        check(CB3R2R_3E<vec3, false>(x0), CB3R2R_3E<vec3, true>(x0),
+            TimeStepAdaptive(1e-6, 1e-6, 1e-2), std::integral_constant<std::size_t, 4>());
+
+        // the accepted adaptive steps record the state only, without
+        // evaluating the system more than without a cache
+        auto l          = CountingLorenz();
+        auto sys_l      = System(l, l);
+        auto ma         = CB3R2R_3E<vec3, false>(x0);
+        auto stepping_a = TimeStepAdaptive(1e-6, 1e-6, 1e-2);
+        auto phi_a      = Flow(sys_l, ma, stepping_a);
+        vec3 xa         = x0;
+        phi_a(xa, 0.0, 0.5);
+        std::size_t nevals = l.nevals;
+
+        auto cache_a = RAMStageCache<vec3, 4>();
+        vec3 xb      = x0;
+        l.nevals     = 0;
+        phi_a.set_local_recomputation(true);
+        phi_a(xb, 0.0, 0.5, cache_a);
+        REQUIRE(l.nevals == nevals);
+        REQUIRE((xa == xb).min());
+        REQUIRE(cache_a.stored() == cache_a.size());
+
+        // and the adjoint forms each step again once, with the stages
+        // kept from the attempt that is accepted
+        auto l_adj   = LorenzAdj(1);
+        auto sys_adj = System(l_adj, l_adj);
+        auto mw      = CB3R2R_3E<vec3, true>(x0);
+        auto stepping_w = TimeStepFromStageCache();
+        auto phi_w   = Flow(sys_adj, mw, stepping_w);
+        vec3 w       = { 4.0, 5.0, 7.0 };
+        l.nevals     = 0;
+        phi_w(w, cache_a);
+        REQUIRE(l.nevals == 4 * cache_a.size());
+
+        // attempting and accepting a step again records the stages of the
+        // attempt, and restores the previous setting
+        auto stages_r = _StepStages<vec3>();
+        auto stages_s = _StepStages<vec3>();
+        vec3 xr       = x0;
+        vec3 xs       = x0;
+        l.nevals      = 0;
+        _recompute_step(ma, sys_l, 0.0, 1e-3, xr, stages_r, 0L);
+        REQUIRE(l.nevals == 4);
+        REQUIRE(!ma.record_stages(false));
+        step(ma, sys_l, 0.0, 1e-3, xs, stages_s);
+        REQUIRE((xr == xs).min());
+        for (std::size_t k = 0; k != 4; k++)
+            REQUIRE((stages_r[k] == stages_s[k]).min());
+
+        // caches without support for it throw
+        auto a        = Lorenz(1);
+        auto sys      = System(a, a);
+        auto m        = RK4<vec3, false>(x0);
+        auto stepping = TimeStepConstant(0.005);
+        auto phi      = Flow(sys, m, stepping);
+        auto cache    = CompressedStageCache<vec3, 4>();
+        vec3 x        = x0;
+        phi.set_local_recomputation(true);
+        REQUIRE_THROWS_AS(phi(x, 0.0, 0.5, cache), std::invalid_argument);
+
+        // methods with a history between steps are rejected
+        auto ms     = IMEXMultistep<SBDF2, vec3>(x0);
+        auto phi_ms = Flow(sys, ms, stepping);
+        REQUIRE_THROWS_AS(phi_ms.set_local_recomputation(true), std::invalid_argument);
+        REQUIRE(!phi_ms.local_recomputation());
+
+        auto mr     = RosenbrockW<ROS2, vec3>(x0);
+        auto phi_mr = Flow(sys, mr, stepping);
+        REQUIRE_THROWS_AS(phi_mr.set_local_recomputation(true), std::invalid_argument);
     }
-}
\ No newline at end of file
+}
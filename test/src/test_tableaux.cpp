@@ -1,3 +1,4 @@
+#include <cmath>
 #include "catch.hpp"
 #include "Flows.hpp"
 
@@ -36,4 +37,96 @@ TEST_CASE( "Testing tableaux", "[tableaux]" ) {
     REQUIRE( tab('E', 'c',    0) == 0.0/1.0 );
     REQUIRE( tab('E', 'c',    1) == 2.0/5.0 );
     REQUIRE( tab('E', 'c',    2) == 1.0/1.0 );
-}
\ No newline at end of file
+
+    // compile time access
+    static_assert( Flows::CB2.a<'I', 2, 1>() == 5.0/6.0 );
+    static_assert( Flows::CB2.a<'E', 1, 0>() == 2.0/5.0 );
+    static_assert( Flows::CB2.b<'I', 0>()    == 0.0/1.0 );
+    static_assert( Flows::CB2.c<'E', 1>()    == 2.0/5.0 );
+    static_assert( Flows::CB3e.b<'I', 2>()   == -1.0/4.0 );
+    static_assert( Flows::CB3e('E', 'a', 3, 2) == 1.0/4.0 );
+    REQUIRE( tab.a<'I', 1, 1>() == tab('I', 'a', 1, 1) );
+    REQUIRE( tab.b<'E', 2>()    == tab('E', 'b',    2) );
+}
+
+TEST_CASE( "Testing CB4 order conditions", "[tableaux]" ) {
+    // same weights and nodes for both parts
+    auto tab = Flows::CB4;
+    double b1 = 0, bc = 0, bc2 = 0, bc3 = 0;
+    for (int i = 0; i != 6; i++) {
+        double cI = 0, cE = 0;
+        for (int j = 0; j != 6; j++) {
+            cI += tab('I', 'a', i, j);
+            cE += tab('E', 'a', i, j);
+        }
+        REQUIRE( std::fabs(cI - cE) < 1e-15 );
+        REQUIRE( std::fabs(cI - tab('I', 'c', i)) < 1e-15 );
+        REQUIRE( tab('I', 'b', i) == tab('E', 'b', i) );
+
+        b1  += tab('I', 'b', i);
+        bc  += tab('I', 'b', i) * cI;
+        bc2 += tab('I', 'b', i) * cI * cI;
+        bc3 += tab('I', 'b', i) * cI * cI * cI;
+    }
+    REQUIRE( std::fabs(b1  - 1.0/1.0) < 1e-15 );
+    REQUIRE( std::fabs(bc  - 1.0/2.0) < 1e-15 );
+    REQUIRE( std::fabs(bc2 - 1.0/3.0) < 1e-15 );
+    REQUIRE( std::fabs(bc3 - 1.0/4.0) < 1e-15 );
+
+    // the last row of the implicit part is the weights
+    for (int j = 0; j != 6; j++)
+        REQUIRE( tab('I', 'a', 5, j) == tab('I', 'b', j) );
+}
+
+TEST_CASE( "Testing 2R order conditions", "[tableaux]" ) {
+    // Butcher matrix of the 2R form, with a_ij = b_j for j < i - 1
+    auto tab = Flows::LowStorage2R5;
+    double A[9][9] = {}, c[9] = {};
+    for (int i = 1; i != 9; i++) {
+        for (int j = 0; j < i - 1; j++)
+            A[i][j] = tab('b', j);
+        A[i][i - 1] = tab('a', i - 1);
+    }
+    for (int i = 0; i != 9; i++) {
+        for (int j = 0; j != 9; j++)
+            c[i] += A[i][j];
+        REQUIRE( std::fabs(c[i] - tab('c', i)) < 1e-15 );
+    }
+
+    // quadrature conditions to fifth order, and some of the others
+    double bc[5] = {}, bAc = 0, bAc2 = 0, bAAc = 0, bcAc = 0, bAc3 = 0, bAAAc = 0;
+    for (int i = 0; i != 9; i++) {
+        double Ac = 0, Ac2 = 0, AAc = 0, Ac3 = 0, AAAc = 0;
+        for (int j = 0; j != 9; j++) {
+            double Ajc = 0, AAjc = 0;
+            for (int k = 0; k != 9; k++) {
+                Ajc += A[j][k] * c[k];
+                double Akc = 0;
+                for (int l = 0; l != 9; l++)
+                    Akc += A[k][l] * c[l];
+                AAjc += A[j][k] * Akc;
+            }
+            Ac   += A[i][j] * c[j];
+            Ac2  += A[i][j] * c[j] * c[j];
+            Ac3  += A[i][j] * c[j] * c[j] * c[j];
+            AAc  += A[i][j] * Ajc;
+            AAAc += A[i][j] * AAjc;
+        }
+        for (int q = 0; q != 5; q++)
+            bc[q] += tab('b', i) * std::pow(c[i], q);
+        bAc   += tab('b', i) * Ac;
+        bAc2  += tab('b', i) * Ac2;
+        bAAc  += tab('b', i) * AAc;
+        bcAc  += tab('b', i) * c[i] * Ac;
+        bAc3  += tab('b', i) * Ac3;
+        bAAAc += tab('b', i) * AAAc;
+    }
+    for (int q = 0; q != 5; q++)
+        REQUIRE( std::fabs(bc[q] - 1.0 / (q + 1)) < 1e-15 );
+    REQUIRE( std::fabs(bAc   - 1.0/6.0)   < 1e-15 );
+    REQUIRE( std::fabs(bAc2  - 1.0/12.0)  < 1e-15 );
+    REQUIRE( std::fabs(bAAc  - 1.0/24.0)  < 1e-15 );
+    REQUIRE( std::fabs(bcAc  - 1.0/8.0)   < 1e-15 );
+    REQUIRE( std::fabs(bAc3  - 1.0/20.0)  < 1e-15 );
+    REQUIRE( std::fabs(bAAAc - 1.0/120.0) < 1e-15 );
+}